@@ -1,5 +1,12 @@
 vienna_build_add_definitions(-DBOOST_NO_LONG_LONG=1)
 
+# the DFISE readers use 32 bit vertex and element indices by default, the index type is part of their interface
+# so the define has to be visible to every project using them
+option(VIENNAUTILS_DFISE_64BIT_INDICES "Use std::size_t instead of 32 bit vertex and element indices in the DFISE readers" OFF)
+if (VIENNAUTILS_DFISE_64BIT_INDICES)
+  vienna_build_add_definitions(-DVIENNAUTILS_DFISE_64BIT_INDICES=1)
+endif ()
+
 # libraries in override take precedence over system libraries
 vienna_build_include_directories(BEFORE override)
 vienna_build_include_directories(include)
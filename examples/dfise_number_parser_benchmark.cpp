@@ -0,0 +1,115 @@
+/* compares the conversion of the numbers in the Values (.dat) or Vertices (.grd) blocks of a DF-ISE file
+ * using boost::lexical_cast (the former conversion path of primary_reader) and viennautils::dfise::parse_number
+ *
+ * usage: dfise_number_parser_benchmark <file.dat|file.grd> [repetitions]
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include "viennautils/timer.hpp"
+#include "viennautils/dfise/number_parser.hpp"
+#include "viennautils/dfise/token_parser.hpp"
+
+namespace dfise = viennautils::dfise;
+
+namespace
+{
+
+//collects all tokens of all Values and Vertices blocks
+void collect_numeric_tokens(dfise::token_parser & tp, std::vector<dfise::token> & tokens)
+{
+  while (tp.has_next())
+  {
+    dfise::token tok = tp.get_next();
+    if (tok == "Values" || tok == "Vertices")
+    {
+      tp.expect("(", "expected parameter parenthesis");
+      tp.get_next();
+      tp.expect(")", "expected parameter to end");
+      tp.expect("{", "expected begin of block");
+      for (dfise::token value = tp.get_next(); value != "}"; value = tp.get_next())
+      {
+        tokens.push_back(value);
+      }
+    }
+  }
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    std::cerr << "usage: " << argv[0] << " <file.dat|file.grd> [repetitions]" << std::endl;
+    return 1;
+  }
+  int repetitions = (argc > 2) ? std::atoi(argv[2]) : 5;
+
+  try
+  {
+    dfise::token_parser tp(argv[1]);
+    std::vector<dfise::token> tokens;
+    collect_numeric_tokens(tp, tokens);
+    std::cout << "numbers: " << tokens.size() << std::endl;
+    if (tokens.empty())
+    {
+      return 0;
+    }
+
+    std::vector<double> lexical_cast_values(tokens.size());
+    std::vector<double> parse_number_values(tokens.size());
+    double lexical_cast_time = 0.0;
+    double parse_number_time = 0.0;
+    viennautils::Timer timer;
+
+    for (int r = 0; r < repetitions; ++r)
+    {
+      timer.start();
+      for (std::size_t i = 0; i < tokens.size(); ++i)
+      {
+        lexical_cast_values[i] = boost::lexical_cast<double>(tokens[i].begin(), tokens[i].size());
+      }
+      lexical_cast_time += timer.get();
+
+      timer.start();
+      for (std::size_t i = 0; i < tokens.size(); ++i)
+      {
+        if (!dfise::parse_number(tokens[i].begin(), tokens[i].end(), parse_number_values[i]))
+        {
+          std::cerr << "parse_number failed for: " << tokens[i].str() << std::endl;
+          return 1;
+        }
+      }
+      parse_number_time += timer.get();
+    }
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < tokens.size(); ++i)
+    {
+      if (lexical_cast_values[i] != parse_number_values[i])
+      {
+        if (mismatches++ < 10)
+        {
+          std::cerr << "mismatch for " << tokens[i].str() << std::endl;
+        }
+      }
+    }
+
+    double const numbers = static_cast<double>(tokens.size()) * repetitions;
+    std::cout << "lexical_cast: " << lexical_cast_time << " s (" << numbers/lexical_cast_time/1e6 << " M numbers/s)" << std::endl;
+    std::cout << "parse_number: " << parse_number_time << " s (" << numbers/parse_number_time/1e6 << " M numbers/s)" << std::endl;
+    std::cout << "speedup:      " << lexical_cast_time/parse_number_time << std::endl;
+    std::cout << "mismatches:   " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 1;
+  }
+  catch (std::exception const & e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
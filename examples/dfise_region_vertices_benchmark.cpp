@@ -0,0 +1,188 @@
+/* measures the construction of a data_reader (which computes the vertex sets of all regions) for a single region grid
+ * made up of n^3 cubes that are split into 6 tetrahedra each
+ *
+ * usage: dfise_region_vertices_benchmark [n (default 80, i.e. ~3 million tetrahedra)] [grid file (default region_benchmark.grd)]
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <boost/array.hpp>
+
+#include "viennautils/timer.hpp"
+#include "viennautils/dfise/data_reader.hpp"
+#include "viennautils/dfise/grd_bnd_reader.hpp"
+
+namespace dfise = viennautils::dfise;
+
+namespace
+{
+
+typedef boost::array<unsigned int, 2> Edge;
+typedef boost::array<unsigned int, 3> Face;
+typedef boost::array<unsigned int, 4> Tetrahedron;
+
+template <typename T>
+std::size_t find_index(std::vector<T> const & sorted, T const & value)
+{
+  return std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+}
+
+//edges are stored with ascending vertex indices, a negative index reverses the edge
+long oriented_edge(std::vector<Edge> const & edges, unsigned int from, unsigned int to)
+{
+  Edge e = {{std::min(from, to), std::max(from, to)}};
+  long index = static_cast<long>(find_index(edges, e));
+  return (from < to) ? index : -index-1;
+}
+
+void write_grid(std::string const & filename, unsigned int n)
+{
+  unsigned int const m = n+1;
+  std::vector<Tetrahedron> tetrahedra;
+  tetrahedra.reserve(6*n*n*n);
+  //every tetrahedron contains the diagonal from corner 0 to corner 7 of its cube
+  unsigned int const paths[6][2] = {{1,3}, {1,5}, {2,3}, {2,6}, {4,5}, {4,6}};
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    for (unsigned int j = 0; j < n; ++j)
+    {
+      for (unsigned int k = 0; k < n; ++k)
+      {
+        unsigned int corners[8];
+        for (unsigned int c = 0; c < 8; ++c)
+        {
+          corners[c] = ((i + (c>>2 & 1))*m + (j + (c>>1 & 1)))*m + (k + (c & 1));
+        }
+        for (unsigned int t = 0; t < 6; ++t)
+        {
+          Tetrahedron tet = {{corners[0], corners[paths[t][0]], corners[paths[t][1]], corners[7]}};
+          tetrahedra.push_back(tet);
+        }
+      }
+    }
+  }
+
+  std::vector<Face> faces;
+  faces.reserve(4*tetrahedra.size());
+  for (std::size_t t = 0; t < tetrahedra.size(); ++t)
+  {
+    for (unsigned int skip = 0; skip < 4; ++skip)
+    {
+      Face f;
+      for (unsigned int v = 0, fv = 0; v < 4; ++v)
+      {
+        if (v != skip)
+        {
+          f[fv++] = tetrahedra[t][v];
+        }
+      }
+      std::sort(f.begin(), f.end());
+      faces.push_back(f);
+    }
+  }
+  std::sort(faces.begin(), faces.end());
+  faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+
+  std::vector<Edge> edges;
+  edges.reserve(3*faces.size());
+  for (std::size_t f = 0; f < faces.size(); ++f)
+  {
+    Edge e0 = {{faces[f][0], faces[f][1]}};
+    Edge e1 = {{faces[f][1], faces[f][2]}};
+    Edge e2 = {{faces[f][0], faces[f][2]}};
+    edges.push_back(e0);
+    edges.push_back(e1);
+    edges.push_back(e2);
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  std::ofstream file(filename.c_str());
+  file << "DF-ISE text\n\nInfo {\n  version = 1.0\n  type = grid\n  dimension = 3\n"
+       << "  nb_vertices = " << m*m*m << "\n  nb_edges = " << edges.size() << "\n  nb_faces = " << faces.size()
+       << "\n  nb_elements = " << tetrahedra.size() << "\n  nb_regions = 1\n"
+       << "  regions = [ \"bulk\" ]\n  materials = [ Silicon ]\n}\n\nData {\n"
+       << "  CoordSystem {\n    translate = [ 0 0 0 ]\n    transform = [ 1 0 0 0 1 0 0 0 1 ]\n  }\n";
+
+  file << "  Vertices (" << m*m*m << ") {\n";
+  for (unsigned int i = 0; i < m*m*m; ++i)
+  {
+    file << "    " << (i/(m*m))*0.1 << " " << (i/m%m)*0.1 << " " << (i%m)*0.1 << "\n";
+  }
+  file << "  }\n  Edges (" << edges.size() << ") {\n";
+  for (std::size_t e = 0; e < edges.size(); ++e)
+  {
+    file << "    " << edges[e][0] << " " << edges[e][1] << "\n";
+  }
+  file << "  }\n  Faces (" << faces.size() << ") {\n";
+  for (std::size_t f = 0; f < faces.size(); ++f)
+  {
+    file << "    3 " << oriented_edge(edges, faces[f][0], faces[f][1])
+         << " "     << oriented_edge(edges, faces[f][1], faces[f][2])
+         << " "     << oriented_edge(edges, faces[f][2], faces[f][0]) << "\n";
+  }
+  file << "  }\n  Locations (" << tetrahedra.size() << ") {\n";
+  for (std::size_t t = 0; t < tetrahedra.size(); ++t)
+  {
+    file << " i";
+  }
+  file << "\n  }\n  Elements (" << tetrahedra.size() << ") {\n";
+  for (std::size_t t = 0; t < tetrahedra.size(); ++t)
+  {
+    file << "    5";
+    for (unsigned int skip = 0; skip < 4; ++skip)
+    {
+      Face f;
+      for (unsigned int v = 0, fv = 0; v < 4; ++v)
+      {
+        if (v != skip)
+        {
+          f[fv++] = tetrahedra[t][v];
+        }
+      }
+      std::sort(f.begin(), f.end());
+      file << " " << find_index(faces, f);
+    }
+    file << "\n";
+  }
+  file << "  }\n  Region (\"bulk\") {\n    material = Silicon\n    Elements (" << tetrahedra.size() << ") {\n";
+  for (std::size_t t = 0; t < tetrahedra.size(); ++t)
+  {
+    file << "      " << t << "\n";
+  }
+  file << "    }\n  }\n}\n";
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char** argv)
+{
+  unsigned int n = (argc > 1) ? std::atoi(argv[1]) : 80;
+  std::string filename = (argc > 2) ? argv[2] : "region_benchmark.grd";
+
+  try
+  {
+    viennautils::Timer timer;
+    timer.start();
+    write_grid(filename, n);
+    std::cout << "writing grid with " << 6*n*n*n << " tetrahedra: " << timer.get() << " s" << std::endl;
+
+    timer.start();
+    dfise::grd_bnd_reader gbreader(filename);
+    std::cout << "grd_bnd_reader: " << timer.get() << " s" << std::endl;
+
+    timer.start();
+    dfise::data_reader dreader(gbreader);
+    std::cout << "data_reader (region vertex sets): " << timer.get() << " s" << std::endl;
+  }
+  catch (std::exception const & e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
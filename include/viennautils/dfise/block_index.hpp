@@ -0,0 +1,70 @@
+#ifndef VIENNAUTILS_DFISE_BLOCK_INDEX_HPP
+#define VIENNAUTILS_DFISE_BLOCK_INDEX_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+
+namespace viennautils
+{
+namespace dfise
+{
+
+class token_parser;
+
+/* block_index records the byte offsets of all top-level blocks (Info, Data) and of all blocks directly within them
+ * (CoordSystem, Vertices, Edges, Faces, Locations, Elements, Region(...), Dataset(...), ...)
+ * the contents of the second level blocks are skipped without tokenizing them, so building the index is cheap
+ *
+ * readers use an index if their input_source names one (see input_source::file): primary_reader::skip_block then jumps
+ * over indexed blocks instead of scanning them, which is what dataset_file, reading a region_selection and the pre-scan
+ * of read_mode_parallel_blocks spend most of their time on
+ *
+ * the index can be stored next to the file (see default_index_path), it is written atomically and only used as long as
+ * path, size and modification time of the file match those it was built for (just like snapshots, see snapshot.hpp)
+ */
+class block_index
+{
+public:
+  struct entry
+  {
+    std::string  name_;
+    std::string  parameter_; //quotes are stripped, empty for blocks without parameter
+    unsigned int level_;     //0 for top-level blocks, 1 for blocks within them
+    std::size_t  offset_;    //offset of the block name
+    std::size_t  length_;    //from the block name up to and including the closing }
+  };
+  typedef std::vector<entry> EntryVector;
+
+  //scans the whole content (requires random access), the token_parser is left at the end
+  void build(token_parser & tp);
+
+  //returns false if there is no up to date index for the given file in index_path
+  bool load(std::string const & index_path, std::string const & filename);
+  //the index is written to a temporary file first and then renamed to index_path, throws a parsing_error on failure
+  void save(std::string const & index_path, std::string const & filename) const;
+
+  //in file order, i.e. sorted by offset
+  EntryVector const & get_entries() const {return entries_;}
+
+  //returns 0 if no such block exists (first match in file order)
+  entry const * find(std::string const & name) const;
+  entry const * find(std::string const & name, std::string const & parameter) const;
+  //the block whose name starts at offset
+  entry const * find_at(std::size_t offset) const;
+  //the innermost block that contains offset (but does not start there)
+  entry const * find_enclosing(std::size_t offset) const;
+
+  static std::string default_index_path(std::string const & filename) {return filename + ".idx";}
+
+private:
+  EntryVector entries_;
+};
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef VIENNAUTILS_DFISE_CATALOG_HPP
+#define VIENNAUTILS_DFISE_CATALOG_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "viennautils/dfise/primary_reader.hpp"
+
+namespace viennautils
+{
+namespace dfise
+{
+
+/* file_info holds the metadata of a DF-ISE file, i.e. the content of its Info block
+ */
+struct file_info
+{
+  std::string filepath_;
+  primary_reader::mandatory_info mandatory_info_;
+  std::vector<std::string> regions_;   //grid and boundary files only
+  std::vector<std::string> materials_; //grid and boundary files only
+  std::vector<std::string> datasets_;  //dataset files only
+  std::vector<std::string> functions_; //dataset files only
+};
+
+//reads the header and the Info block of the file but nothing beyond it (the file is memory mapped, hence only the pages
+//holding the Info block are actually read, compressed files are read sequentially and thus only decompressed up to the
+//window holding the Info block) - throws a parsing_error if the file is not a valid DF-ISE file
+file_info peek(std::string const & filepath);
+
+/* catalog lists the metadata of all .grd, .bnd and .dat files within a directory tree (see build_catalog)
+ */
+struct catalog
+{
+  std::vector<file_info> files_;                             //sorted by path
+  std::vector<std::pair<std::string, std::string> > errors_; //path and error message of the files that could not be peeked, sorted by path
+};
+
+//peeks at all .grd, .bnd and .dat files (compressed ones included) within directory and its subdirectories, the files are peeked at in parallel
+//(given OpenMP) - throws a parsing_error if the directory cannot be opened
+catalog build_catalog(std::string const & directory);
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
+
+#endif
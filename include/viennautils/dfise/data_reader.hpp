@@ -8,8 +8,12 @@
 
 #include <boost/container/flat_set.hpp>
 #include <boost/container/flat_map.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/smart_ptr/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "viennautils/dfise/grd_bnd_reader.hpp"
+#include "viennautils/dfise/memory_usage.hpp"
 
 namespace viennautils
 {
@@ -17,6 +21,48 @@ namespace dfise
 {
 
 class primary_reader;
+class snapshot_reader;
+class snapshot_writer;
+
+/* dataset_sink receives the values of a dataset while they are parsed (see data_reader::register_sink)
+ * the values of every Dataset block are passed on in batches, vertices in ascending order, so that they can be scattered
+ * into the final storage without buffering the whole dataset first
+ */
+class dataset_sink
+{
+public:
+  typedef grd_bnd_reader::VertexIndex VertexIndex;
+
+  virtual ~dataset_sink() {}
+
+  //called for every Dataset block of a registered name before its values are passed on
+  //  vertex_count is the number of vertices of all validity regions of the block combined
+  virtual void begin_block( std::string const & /*dataset_name*/, unsigned int /*dimension*/
+                          , std::vector<std::string> const & /*validity*/, std::size_t /*vertex_count*/
+                          ) {}
+  //the values of count vertices: values[i*dimension] ... values[i*dimension + dimension-1] belong to vertices[i]
+  virtual void consume(VertexIndex const * vertices, double const * values, std::size_t count) = 0;
+  virtual void end_block() {}
+};
+
+/* dataset_buffer_sink scatters the values into a caller-owned buffer laid out like a complete dataset, i.e. the values of
+ * vertex v go to buffer[v*dimension] ... buffer[v*dimension + dimension-1]
+ * the buffer has to hold (number of vertices)*dimension values, values of vertices outside the validity are left untouched
+ */
+class dataset_buffer_sink : public dataset_sink
+{
+public:
+  dataset_buffer_sink(double * buffer, unsigned int dimension) : buffer_(buffer), dimension_(dimension) {}
+
+  virtual void begin_block( std::string const & dataset_name, unsigned int dimension
+                          , std::vector<std::string> const & validity, std::size_t vertex_count
+                          );
+  virtual void consume(VertexIndex const * vertices, double const * values, std::size_t count);
+
+private:
+  double * buffer_;
+  unsigned int dimension_;
+};
 
 /* data_reader reads and combines datasets specified in .dat files in dfise text format
  * datasets with identical names within in a single file are combined to a single, final dataset (either partial or complete)
@@ -31,49 +77,191 @@ class primary_reader;
  *   2 partial datasets:
  *   partial dataset with name "D" contains values for region X from A.dat
  *   partial dataset with name "D_B" contains values for region Y from B.dat
+ *
+ * if the grid was read with a region_selection (see grd_bnd_reader), the datasets are subset accordingly:
+ *  - Dataset blocks that are valid on skipped regions only are skipped
+ *  - Dataset blocks that are valid on all regions of the file are reduced to the vertices that were read
+ *  - Dataset blocks that are valid on selected regions only are stored as they are (vertices keep their relative order)
+ *  - anything else (valid on some selected and some skipped regions) is rejected with a parsing_error, the values
+ *    cannot be assigned to vertices without knowing the vertices of the skipped regions
  */
 class data_reader
 {
+  friend class dataset_file;
+
 public:
   typedef std::vector<double> ValueVector;
   typedef std::vector<viennautils::dfise::grd_bnd_reader::VertexIndex> VertexIndexVector;
+  //partial datasets with the same validity share their vertex indices
+  typedef boost::shared_ptr<VertexIndexVector const> SharedVertexIndexVector;
 
   //name, dimension, values
-  typedef std::map<std::string, std::pair<unsigned int, std::pair<VertexIndexVector, ValueVector> > > PartialDatasetMap;
+  typedef std::map<std::string, std::pair<unsigned int, std::pair<SharedVertexIndexVector, ValueVector> > > PartialDatasetMap;
   typedef std::map<std::string, std::pair<unsigned int, ValueVector> > CompleteDatasetMap;
 
-  data_reader(grd_bnd_reader const & gbreader);
+  //mode applies to all files parsed by read (see read_mode), with read_mode_parallel_blocks the Dataset blocks of a file
+  //  are parsed concurrently unless datasets are streamed to sinks
+  data_reader(grd_bnd_reader const & gbreader, read_mode mode = read_mode_direct);
 
   void read(std::string const & filepath);
+  //same as above, but the datasets of the file are restored from the binary snapshot in snapshot_path (see snapshot.hpp)
+  //  if it is up to date, otherwise the file is parsed and the snapshot is (re)written
+  void read(std::string const & filepath, std::string const & snapshot_path);
+  //reads a memory buffer, descriptor or stream (see input_source), the name of the source takes the place of the filepath
+  void read(input_source const & source);
+  //same result as calling read for each of the files in the given order (including the generated dataset names), but
+  //the files are parsed concurrently (given OpenMP) and merged in order as soon as all files before them are merged
+  //  if a file fails, the files before it are merged nonetheless and its error is thrown: parsing_error and
+  //  std::bad_alloc as such, any other exception as std::runtime_error with its message
+  //  with any sinks registered the files are read one after another, since sinks need not be thread-safe
+  void read_many(std::vector<std::string> const & filepaths);
+
+  //datasets with a registered sink are passed to it by read while they are parsed and are not stored in the
+  //partial/complete datasets - the sink has to stay alive as long as it is registered
+  //  files with streamed datasets are not written to snapshots (restored snapshots are streamed from memory though)
+  void register_sink(std::string const & dataset_name, dataset_sink & sink) {sinks_[dataset_name] = &sink;}
+  void unregister_sink(std::string const & dataset_name) {sinks_.erase(dataset_name);}
 
   PartialDatasetMap const & get_partial_datasets() const {return partial_datasets_;}
   CompleteDatasetMap const & get_complete_datasets() const {return complete_datasets_;}
 
+  //the memory held by the datasets and the region information, the peak covers all files read so far (each one while it
+  //is parsed and while it is merged) - read_many accounts for every file on its own, the files parsed concurrently
+  //with it are not added
+  memory_usage get_memory_usage() const;
+
 private:
   struct Dataset;
   typedef std::list<Dataset> DatasetList;
 
   typedef boost::container::flat_set<grd_bnd_reader::VertexIndex> VertexIndexSet;
   typedef boost::container::flat_map<std::string, VertexIndexSet> RegionVertexIndicesMap;
+  //sorted vertex indices, either those of a single region or a union of regions stored elsewhere
+  typedef std::pair<grd_bnd_reader::VertexIndex const *, grd_bnd_reader::VertexIndex const *> VertexIndexRange;
+
+  //returns the memory held by the parsed datasets and the input buffer at the end of parsing
+  std::size_t parse(input_source const & source, DatasetList & datasets);
+  static std::size_t dataset_bytes(DatasetList const & datasets);
+  //records the memory held by the reader plus pending_bytes (datasets not yet merged) if it exceeds the peak so far
+  void update_peak_bytes(std::size_t pending_bytes);
+  bool load_snapshot(snapshot_reader & sreader, DatasetList & datasets) const;
+  void save_snapshot(snapshot_writer & swriter, DatasetList const & datasets) const;
+  void check_basic_info(unsigned int dimension, unsigned int vertex_count, unsigned int element_count, std::size_t region_count) const;
+
+  //how a validity relates to the regions that were read (see region_selection), throws for mixed validities
+  enum validity_scope
+  {
+    validity_selected,
+    validity_skipped,
+    validity_whole_file
+  };
+  validity_scope classify_validity(std::vector<std::string> const & validity) const;
+  //drops the datasets of skipped regions and reduces those of the whole file (see subset_values)
+  void subset_datasets(DatasetList & datasets) const;
+  //keeps the values of the vertices that were read, the validity is reduced to the selected regions
+  void subset_values(Dataset & dataset) const;
 
   void parse_additional_info(primary_reader & preader, DatasetList & datasets);
   void parse_data_block(primary_reader & preader, DatasetList & datasets);
 
-  void combine_region_indices(std::vector<std::string> const & validity, VertexIndexSet & combined_indices);
+  //per dataset name: dimension and validity regions of the blocks streamed so far
+  typedef std::map<std::string, std::pair<unsigned int, boost::container::flat_set<std::string> > > StreamedValidityMap;
+  void stream_dataset_block(primary_reader & preader, Dataset & dataset, StreamedValidityMap & streamed, std::string const & para);
+  void stream_dataset_values_block( primary_reader & preader, Dataset const & dataset, VertexIndexRange const & vertices
+                                  , std::vector<double>::size_type const & para
+                                  );
+  void stream_restored_datasets(DatasetList & datasets);
+  //passes the (already read) values of the dataset on to its sink
+  void stream_values(Dataset const & dataset);
+  void check_streamed_validity(Dataset const & dataset, StreamedValidityMap & streamed) const;
+  bool remove_streamed_datasets(DatasetList & datasets) const;
+
+  void unify_datasets(DatasetList & datasets, std::string const & filepath);
+  void unify_dataset(std::vector<DatasetList::iterator> const & subset, std::string const & filepath);
+  VertexIndexRange combine_region_indices(std::vector<std::string> const & validity);
+  //the union of the vertices of the regions, computed once per set of regions and kept for all further read calls
+  SharedVertexIndexVector validity_union(std::vector<std::string> validity);
   bool is_unique(std::string const & dataset_name) const;
   std::string generate_unique_name(std::string const & dataset_name, std::string const & filepath) const;
 
+  read_mode read_mode_;
   unsigned int dimension_;
   unsigned int vertex_count_;
+  //the numbers of the file (rather than those that were read) if the grid was read with a region_selection
+  unsigned int file_vertex_count_;
   unsigned int element_count_;
+  std::size_t file_region_count_;
+  VertexIndexVector vertex_map_; //see grd_bnd_reader::get_vertex_map, only set if regions were skipped
+  boost::container::flat_set<std::string> skipped_regions_;
   RegionVertexIndicesMap region_vertex_indices_;
+  std::map<std::vector<std::string>, SharedVertexIndexVector> validity_unions_; //keyed by the sorted region names
   PartialDatasetMap partial_datasets_;
   CompleteDatasetMap complete_datasets_;
+  std::map<std::string, dataset_sink *> sinks_;
+  std::size_t peak_bytes_;
 
-  static void parse_dataset_block(primary_reader & preader, Dataset & dataset, std::string const & para);
+  void read_dataset_block(primary_reader & preader, std::vector<Dataset *> const & datasets, std::size_t index) const;
+  void parse_dataset_block(primary_reader & preader, Dataset & dataset, std::string const & para) const;
+  static void parse_dataset_header(primary_reader & preader, Dataset & dataset);
   static void parse_dataset_values_block(primary_reader & preader, std::vector<double> & values, std::vector<double>::size_type const & para);
 };
 
+/* dataset_file provides on-demand access to the datasets of a single .dat file
+ * opening the file only parses the Info block and the headers of all Dataset blocks - their Values blocks are skipped
+ * without tokenizing them. the values of a dataset are read when it is loaded for the first time, they are then unified
+ * and stored in the data_reader just like data_reader::read does it
+ * the file stays opened (memory mapped) for the lifetime of the dataset_file
+ * given a block index (see block_index) the Values blocks are not even skipped but jumped over, which makes opening a
+ * file again almost free of any scanning
+ */
+class dataset_file : boost::noncopyable
+{
+public:
+  struct dataset_info
+  {
+    std::string name_;
+    std::string function_;
+    unsigned int dimension_;
+    std::vector<std::string> validity_; //regions of all Dataset blocks with this name
+  };
+  typedef std::vector<dataset_info> DatasetInfoVector;
+
+  dataset_file(data_reader & reader, std::string const & filepath);
+  //same as above, but the blocks are located through the block index in index_path (see input_source::file)
+  dataset_file(data_reader & reader, std::string const & filepath, std::string const & index_path);
+  ~dataset_file();
+
+  std::string const & get_filepath() const {return filepath_;}
+  DatasetInfoVector const & get_datasets() const {return dataset_infos_;}
+
+  //reads the values of the dataset and stores it in the data_reader (if it was not loaded already)
+  //returns the name under which the dataset can be found in the data_reader's partial/complete datasets
+  std::string const & load(std::string const & dataset_name);
+
+private:
+  struct dataset_block
+  {
+    std::string name_;
+    std::string function_;
+    unsigned int dimension_;
+    std::vector<std::string> validity_;
+    std::size_t values_offset_;
+  };
+  typedef std::vector<dataset_block> DatasetBlockVector;
+
+  void open(std::string const & index_path);
+  void parse_additional_info(primary_reader & preader);
+  void parse_data_block();
+  void parse_dataset_block(dataset_block & block, std::string const & para);
+
+  data_reader & reader_;
+  std::string filepath_;
+  boost::scoped_ptr<primary_reader> preader_;
+  DatasetBlockVector dataset_blocks_;
+  DatasetInfoVector dataset_infos_;
+  std::map<std::string, std::string> loaded_datasets_;
+};
+
 } //end of namespace dfise
 
 } //end of namespace viennautils
@@ -0,0 +1,70 @@
+#ifndef VIENNAUTILS_DFISE_DECOMPRESSION_HPP
+#define VIENNAUTILS_DFISE_DECOMPRESSION_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace viennautils
+{
+namespace dfise
+{
+
+/* compressed DF-ISE files (e.g. .grd.gz or .dat.zst) are recognized by their magic bytes rather than by their extension
+ * gzip support requires VIENNAUTILS_DFISE_ZLIB (cmake: ENABLE_ZLIB), zstd support VIENNAUTILS_DFISE_ZSTD (ENABLE_ZSTD)
+ */
+enum compression
+{
+  compression_none,
+  compression_gzip,
+  compression_zstd
+};
+
+compression detect_compression(char const* data, std::size_t size);
+
+//removes a trailing .gz or .zst from path (e.g. to find out the type of a compressed file by its extension)
+std::string strip_compression_extension(std::string const & path);
+
+/* decompressor decompresses all (concatenated) members or frames of data piece by piece into buffers of the caller
+ * only its own stream state is held in memory, thus content can be read sequentially through a window of bounded size
+ * (see token_parser) instead of decompressing it as a whole
+ */
+class decompressor : boost::noncopyable
+{
+public:
+  //data has to stay alive as long as the decompressor (compression_none merely copies it), throws a parsing_error if
+  //support for the compression was not compiled in
+  decompressor(compression method, char const* data, std::size_t size);
+  ~decompressor();
+
+  //decompresses up to size bytes into target and returns their number, less than size only at the end of the data
+  //throws a parsing_error if the data is corrupt or truncated
+  std::size_t read(char* target, std::size_t size);
+  bool finished() const {return finished_;}
+
+  //the uncompressed size recorded in the data (gzip: of the last member modulo 2^32), 0 if unknown
+  boost::uint64_t get_recorded_size() const;
+
+private:
+  struct stream_state;
+
+  compression method_;
+  char const* data_;
+  std::size_t size_;
+  bool finished_;
+  stream_state* state_;
+};
+
+//decompresses all (concatenated) members or frames of data into target, which is sized using the uncompressed size
+//recorded in the data (if any) so that it usually does not have to grow
+//throws a parsing_error if the data is corrupt or if support for the compression was not compiled in
+void decompress(compression method, char const* data, std::size_t size, std::vector<char> & target);
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
+
+#endif
@@ -1,24 +1,43 @@
 #ifndef VIENNAUTILS_DFISE_GRID_READER_HPP
 #define VIENNAUTILS_DFISE_GRID_READER_HPP
 
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <map>
+#include <utility>
 
 #include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+
+#include "viennautils/dfise/input_source.hpp"
+#include "viennautils/dfise/memory_usage.hpp"
+#include "viennautils/dfise/token_pipeline.hpp"
 
 namespace viennautils
 {
 namespace dfise
 {
 
+//type of vertex and element indices (and thus of all connectivity information)
+//  32 bit indices suffice for almost all meshes and halve the memory of the connectivity, define
+//  VIENNAUTILS_DFISE_64BIT_INDICES (CMake option of the same name) to use std::size_t instead
+//  files with more vertices, elements or element vertex references than the index type can represent are rejected while parsing
+#ifdef VIENNAUTILS_DFISE_64BIT_INDICES
+typedef std::size_t index_type;
+#else
+typedef boost::uint32_t index_type;
+#endif
+
 class primary_reader;
+class snapshot_reader;
+class snapshot_writer;
 
 class grd_bnd_reader
 {
 public:
   typedef std::vector<double> VertexVector;
-  typedef VertexVector::size_type VertexIndex;
+  typedef index_type VertexIndex;
   
   enum filetype
   {
@@ -42,7 +61,30 @@ public:
   };
 
   typedef std::vector<element> ElementVector;
-  typedef std::vector<element>::size_type ElementIndex;
+  typedef index_type ElementIndex;
+
+  /* compressed sparse row (CSR) storage of all elements
+   * instead of one heap allocated vector per element there is one tag array, one offset array and a single flat array
+   * holding the vertex indices of all elements: the vertices of element i are
+   * vertex_indices_[offsets_[i]] ... vertex_indices_[offsets_[i+1]-1], offsets_ thus contains one entry more than there are elements
+   */
+  struct element_connectivity
+  {
+    typedef index_type Offset;
+    typedef std::vector<VertexIndex>::const_iterator VertexIterator;
+
+    ElementIndex size() const {return tags_.size();}
+    bool empty() const {return tags_.empty();}
+
+    element_tag    tag(ElementIndex element)            const {return static_cast<element_tag>(tags_[element]);}
+    Offset         vertex_count(ElementIndex element)   const {return offsets_[element+1] - offsets_[element];}
+    VertexIterator vertices_begin(ElementIndex element) const {return vertex_indices_.begin() + offsets_[element];}
+    VertexIterator vertices_end(ElementIndex element)   const {return vertex_indices_.begin() + offsets_[element+1];}
+
+    std::vector<unsigned char> tags_; //element_tag values, stored as bytes
+    std::vector<Offset>        offsets_;
+    std::vector<VertexIndex>   vertex_indices_;
+  };
 
   struct region
   {
@@ -50,16 +92,107 @@ public:
     std::vector<ElementIndex> element_indices_;
   };
   typedef std::map<std::string, region> RegionMap;
+  
+  /* region_selection restricts reading a grid to some of its regions, selected by name or by material (a region is
+   * selected if either matches) - only the elements of the selected regions are stored and only the vertices these
+   * elements refer to
+   * the remaining vertices and elements are renumbered consecutively, keeping their relative order, see get_vertex_map
+   * and get_element_map for the correspondence to the indices within the file
+   * names or materials that do not match any region are rejected with a parsing_error
+   */
+  struct region_selection
+  {
+    std::vector<std::string> regions_;
+    std::vector<std::string> materials_;
+  };
+  
+  //marks vertices and elements that were not read in the vertex and element maps
+  static index_type const invalid_index = static_cast<index_type>(-1);
+  
+  /* element_buckets stores the elements grouped by their tag, one bucket per tag: lines, triangles, quadrilaterals and
+   * tetrahedra are stored as contiguous arrays with a fixed number of vertices per element (e.g. the vertices of the
+   * tetrahedron in slot s are vertex_indices(element_tag_tetrahedron)[4*s] ... [4*s+3]), polygons in CSR layout
+   * the slots of every bucket are ordered by region (in the order of the RegionMap, elements in the order of the region),
+   * thus the elements of a region form one contiguous range of slots per bucket - elements that do not belong to any
+   * region come last, elements that belong to more than one region are stored once per region
+   */
+  struct element_buckets
+  {
+    typedef index_type Slot;
+    typedef std::pair<Slot, Slot> SlotRange; //[first, second)
+    static std::size_t const bucket_count = 5;
+    typedef boost::array<SlotRange, bucket_count> SlotRanges; //indexed by bucket_index
+    
+    static std::size_t bucket_index(element_tag tag) {return tag - 1;}
+    //number of vertices per element, 0 for polygons
+    static unsigned int arity(element_tag tag);
+    
+    Slot size(element_tag tag) const {return static_cast<Slot>(elements_[bucket_index(tag)].size());}
+    std::vector<VertexIndex> const &  vertex_indices(element_tag tag) const {return vertex_indices_[bucket_index(tag)];}
+    //the element index of every slot
+    std::vector<ElementIndex> const & elements(element_tag tag)       const {return elements_[bucket_index(tag)];}
+    
+    //the slots of the elements of a region (or of the elements that do not belong to any region)
+    SlotRange region_slots(std::string const & region_name, element_tag tag) const;
+    SlotRange unassigned_slots(element_tag tag) const {return unassigned_slots_[bucket_index(tag)];}
+    
+    //the bucket (i.e. the tag) and slot of every element, the first one if it is stored more than once
+    element_tag element_bucket(ElementIndex element) const {return static_cast<element_tag>(element_tags_[element]);}
+    Slot        element_slot(ElementIndex element)   const {return element_slots_[element];}
+    
+    boost::array<std::vector<VertexIndex>, bucket_count>  vertex_indices_;
+    //the vertices of polygon s are vertex_indices(element_tag_polygon)[polygon_offsets_[s]] ... [polygon_offsets_[s+1]-1]
+    std::vector<element_connectivity::Offset>             polygon_offsets_;
+    boost::array<std::vector<ElementIndex>, bucket_count> elements_;
+    std::map<std::string, SlotRanges>                     region_slots_;
+    SlotRanges                                            unassigned_slots_;
+    std::vector<unsigned char>                            element_tags_;
+    std::vector<Slot>                                     element_slots_;
+  };
+
+  //read_mode_pipelined overlaps tokenizing and converting the file with parsing it (see token_pipeline)
+  //read_mode_parallel_blocks parses the Region blocks concurrently (see primary_reader::read_blocks)
+  grd_bnd_reader(std::string const & filename, read_mode mode = read_mode_direct);
+  //same as above, but the grid is restored from the binary snapshot in snapshot_path (see snapshot.hpp) if it is up to date
+  //  otherwise the file is parsed and the snapshot is (re)written
+  grd_bnd_reader(std::string const & filename, std::string const & snapshot_path, read_mode mode = read_mode_direct);
+
+  //reads the grid from a memory buffer, descriptor or stream (see input_source)
+  explicit grd_bnd_reader(input_source const & source, read_mode mode = read_mode_direct);
 
-  grd_bnd_reader(std::string const & filename);
+  //reads the selected regions only (see region_selection), such files are always read directly (without pipelining)
+  //  since the Elements and Vertices blocks are read after the Region blocks that follow them
+  grd_bnd_reader(std::string const & filename, region_selection const & selection);
+  grd_bnd_reader(input_source const & source, region_selection const & selection);
 
-  filetype              get_file_type() const {return filetype_;}
-  unsigned int          get_dimension() const {return dimension_;}
-  VertexVector const &  get_vertices()  const {return vertices_;} //actually it is the vertex coordinate vector
-  ElementVector const & get_elements()  const {return elements_;}
-  RegionMap const &     get_regions()   const {return regions_;}
-  std::vector<double>   get_transform() const {return trans_matrix_;}
-  std::vector<double>   get_translate() const {return trans_move_;}
+  filetype                     get_file_type()            const {return filetype_;}
+  unsigned int                 get_dimension()            const {return dimension_;}
+  VertexVector const &         get_vertices()             const {return vertices_;} //actually it is the vertex coordinate vector
+  element_connectivity const & get_element_connectivity() const {return connectivity_;}
+  RegionMap const &            get_regions()              const {return regions_;}
+  std::vector<double>          get_transform()            const {return trans_matrix_;}
+  std::vector<double>          get_translate()            const {return trans_move_;}
+
+  //vertex/element index within the file -> index within this reader (invalid_index if it was not read)
+  //  both are empty unless the grid was read with a region_selection
+  std::vector<VertexIndex> const &  get_vertex_map()      const {return vertex_map_;}
+  std::vector<ElementIndex> const & get_element_map()     const {return element_map_;}
+  //the regions of the file that were not selected
+  std::vector<std::string> const &  get_skipped_regions() const {return skipped_regions_;}
+
+  //compatibility view of the element connectivity with one vector per element
+  //  it is assembled (and cached) upon the first call and takes considerably more memory than the CSR layout
+  //  may be called concurrently (given OpenMP), the view is assembled only once
+  ElementVector const & get_elements() const;
+  
+  //the elements grouped by tag (see element_buckets), assembled (and cached) upon the first call
+  //  takes about as much memory as the element connectivity
+  //  may be called concurrently (given OpenMP), the buckets are assembled only once
+  element_buckets const & get_element_buckets() const;
+  
+  //the memory held by every structure of the grid (the cached views included, once assembled) and the peak while parsing
+  //  a grid restored from a snapshot reports the memory after restoring it as peak
+  memory_usage get_memory_usage() const;
 
 private:
   struct GrdBndInfo
@@ -74,17 +207,47 @@ private:
   typedef boost::array<int, 3> Face;
   typedef std::vector<Face> FaceVector;
 
+  //edges and faces are only needed to resolve the elements, they are released as soon as parsing is done
+  struct parse_temporaries
+  {
+    parse_temporaries() : selection_(0) {}
+
+    GrdBndInfo info_;
+    EdgeVector edges_;
+    FaceVector faces_;
+    std::vector<region> regions_; //in Info block order, Region blocks might be parsed concurrently (see merge_regions)
+    region_selection const * selection_;
+  };
+
+  void parse(input_source const & source, read_mode mode, region_selection const * selection = 0);
+  //records the memory held at this point of parsing if it exceeds the peak so far
+  void update_peak_bytes(primary_reader const & preader);
+  //appends element to its bucket (first_slot: the slot is the one recorded for the element)
+  void add_to_bucket(ElementIndex element, bool first_slot) const;
+  bool load_snapshot(snapshot_reader & sreader);
+  void save_snapshot(snapshot_writer & swriter) const;
+
   void parse_additional_info(primary_reader & preader);
   void parse_data_block(primary_reader & preader);
+  //the Data block of a grid read with a region_selection
+  void parse_selected_data_block(primary_reader & preader);
+  //flags the regions of the Info block that are selected, skipped_regions_ receives the others
+  std::vector<bool> select_regions(region_selection const & selection);
+  //numbers the flagged entries of map consecutively and sets the others to invalid_index, returns the count
+  static index_type compact_index_map(std::vector<index_type> & map);
   void parse_coord_system_block(primary_reader & preader);
   void parse_vertices_block(primary_reader & preader, unsigned int const & para);
   void parse_edges_block(primary_reader & preader, unsigned int const & para);
   void parse_faces_block(primary_reader & preader, unsigned int const & para);
-  void parse_locations_block(primary_reader & preader, unsigned int const & para);
   void parse_elements_block(primary_reader & preader, unsigned int const & para);
+  //reads the Region block of the given index if it is selected, skips it otherwise
+  void read_region_block(primary_reader & preader, std::vector<bool> const & selected, std::vector<std::string>::size_type region_index);
+  //moves the parsed regions to regions_
+  void merge_regions(std::vector<bool> const & selected);
   void parse_region_block(primary_reader & preader, std::vector<std::string>::size_type region_index, std::string const & para);
   void parse_region_element_block(primary_reader & preader, std::vector<std::string>::size_type region_index, std::vector<ElementIndex>::size_type const & para);
 
+  void check_index_range(std::size_t count, std::string const & what);
   void read_vertex_index(primary_reader & preader, VertexIndex & index);
   //edge indices can be signed indicating the orientation of the edge
   void read_edge_index(primary_reader & preader, int & index);
@@ -94,19 +257,26 @@ private:
   VertexIndex get_oriented_edge_vertex(int edge_index, Edge::size_type vertex_index);
   VertexIndex get_oriented_face_vertex(int face_index, EdgeIndex edge_index, Edge::size_type vertex_index);
 
-  //"temporary" data (only used during parsing - in an entire proper design these would not be data members)
-  GrdBndInfo grd_bnd_info_;
-  EdgeVector edges_;
-  FaceVector faces_;
+  parse_temporaries * temporaries_; //points to the temporaries on the stack of parse while parsing, 0 otherwise
+  std::size_t peak_bytes_;
 
   //"final" data
-  unsigned int        dimension_;
-  filetype            filetype_;
-  VertexVector        vertices_;
-  ElementVector       elements_;
-  RegionMap           regions_;
-  std::vector<double> trans_matrix_;
-  std::vector<double> trans_move_;
+  unsigned int          dimension_;
+  filetype              filetype_;
+  VertexVector          vertices_;
+  element_connectivity  connectivity_;
+  RegionMap             regions_;
+  std::vector<double>   trans_matrix_;
+  std::vector<double>   trans_move_;
+
+  //only filled when reading with a region_selection
+  std::vector<VertexIndex>  vertex_map_;
+  std::vector<ElementIndex> element_map_;
+  std::vector<std::string>  skipped_regions_;
+
+  mutable ElementVector elements_; //only assembled by get_elements
+  mutable element_buckets buckets_; //only assembled by get_element_buckets
+  mutable bool buckets_assembled_;
 };
 
 } //end of namespace dfise
@@ -0,0 +1,68 @@
+#ifndef VIENNAUTILS_DFISE_INPUT_SOURCE_HPP
+#define VIENNAUTILS_DFISE_INPUT_SOURCE_HPP
+
+#include <string>
+#include <istream>
+#include <cstddef>
+
+namespace viennautils
+{
+namespace dfise
+{
+
+/* input_source describes where the content of a DF-ISE file comes from, token_parser loads it as one contiguous block of
+ * memory (compressed content is decompressed as a whole or through a window, see access_mode):
+ *  - file:       the file is memory mapped (see mapped_file)
+ *  - memory:     the buffer is parsed in place without any copy, it has to stay alive and unchanged as long as the
+ *                readers parsing it (i.e. their token_parser) are alive
+ *  - descriptor: regular files are memory mapped, anything else (pipes, sockets, ...) is read up to its end in large
+ *                chunks, the descriptor is not closed
+ *  - stream:     the stream is read up to its end
+ * sources that cannot seek (pipes and streams) are thus read completely before parsing starts, afterwards all of them
+ * can be seeked within just like files
+ * the name is used in error messages and to name datasets (see data_reader), for files it is the path
+ * files may name a block_index, readers then locate blocks through it instead of skipping them (see primary_reader)
+ */
+class input_source
+{
+public:
+  enum source_type
+  {
+    source_type_file,
+    source_type_memory,
+    source_type_descriptor,
+    source_type_stream
+  };
+
+  //the block index is loaded from index_path (or built and stored there if it is missing or out of date), none is used
+  //  if index_path is empty (see block_index::default_index_path)
+  static input_source file(std::string const & path, std::string const & index_path = std::string());
+  static input_source memory(char const* data, std::size_t size, std::string const & name = "<memory>");
+  static input_source descriptor(int descriptor, std::string const & name = "<descriptor>");
+  static input_source stream(std::istream & stream, std::string const & name = "<stream>");
+
+  source_type         get_type()       const {return type_;}
+  std::string const & get_name()       const {return name_;}
+  char const*         get_data()       const {return data_;}       //memory only
+  std::size_t         get_size()       const {return size_;}       //memory only
+  int                 get_descriptor() const {return descriptor_;} //descriptor only
+  std::istream *      get_stream()     const {return stream_;}     //stream only
+  std::string const & get_index_path() const {return index_path_;} //file only
+
+private:
+  input_source(source_type type, std::string const & name);
+
+  source_type    type_;
+  std::string    name_;
+  char const*    data_;
+  std::size_t    size_;
+  int            descriptor_;
+  std::istream * stream_;
+  std::string    index_path_;
+};
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
+
+#endif
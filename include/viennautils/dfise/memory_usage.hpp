@@ -0,0 +1,54 @@
+#ifndef VIENNAUTILS_DFISE_MEMORY_USAGE_HPP
+#define VIENNAUTILS_DFISE_MEMORY_USAGE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstddef>
+
+namespace viennautils
+{
+namespace dfise
+{
+
+/* memory_usage reports the heap memory held by the structures of a reader and the peak seen while parsing
+ * the figures are estimates: vectors count their capacity, strings their capacity, tree nodes their value plus the node
+ * links - the bookkeeping of the allocator itself is not included, neither are memory mapped files (only streams and
+ * compressed files read with random access are held in memory as a whole, see access_mode)
+ */
+struct memory_usage
+{
+  typedef std::vector<std::pair<std::string, std::size_t> > StructureVector;
+
+  memory_usage() : peak_bytes_(0) {}
+
+  void add(std::string const & structure, std::size_t bytes) {structures_.push_back(std::make_pair(structure, bytes));}
+  //the bytes held by all structures combined
+  std::size_t total_bytes() const;
+
+  StructureVector structures_; //name and bytes held of every structure
+  std::size_t peak_bytes_;     //the most bytes held at once while parsing, parse-time temporaries and input buffers included
+};
+
+template<typename T>
+std::size_t heap_bytes(std::vector<T> const & v)
+{
+  return v.capacity() * sizeof(T);
+}
+
+std::size_t heap_bytes(std::string const & s);
+std::size_t heap_bytes(std::vector<std::string> const & v);
+
+//the bytes of a single tree node of a std::map, the values themselves might hold further memory
+template<typename Key, typename Value>
+std::size_t map_node_bytes(std::map<Key, Value> const &)
+{
+  return sizeof(typename std::map<Key, Value>::value_type) + 4*sizeof(void *);
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef VIENNAUTILS_DFISE_NUMBER_PARSER_HPP
+#define VIENNAUTILS_DFISE_NUMBER_PARSER_HPP
+
+#include <limits>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/type_traits/is_signed.hpp>
+#include <boost/type_traits/make_unsigned.hpp>
+#include <boost/utility/enable_if.hpp>
+
+namespace viennautils
+{
+namespace dfise
+{
+
+/* parse_number converts the character range [begin, end) to a number without any detours via streams or locales
+ *  - integers are checked for overflow (and unsigned types reject negative values)
+ *  - doubles are correctly rounded, simple values are converted directly, values with many significant digits or large
+ *    exponents are handed to the C library using a private "C" locale
+ *  - all other types are converted using boost::lexical_cast
+ * returns false if the whole range does not represent a valid value of the target type
+ * all functions are thread-safe and do not touch the global locale
+ */
+
+namespace detail
+{
+  template <typename T>
+  struct is_parsable_integer : boost::mpl::bool_<  boost::is_integral<T>::value
+                                                && !boost::is_same<T, bool>::value
+                                                && !boost::is_same<T, char>::value
+                                                && !boost::is_same<T, signed char>::value
+                                                && !boost::is_same<T, unsigned char>::value
+                                                > {};
+
+  template <typename T>
+  struct is_parsable_number : boost::mpl::bool_<is_parsable_integer<T>::value || boost::is_same<T, double>::value> {};
+}
+
+bool parse_number(char const * begin, char const * end, double & value);
+
+template <typename T>
+typename boost::enable_if<detail::is_parsable_integer<T>, bool>::type parse_number(char const * begin, char const * end, T & value);
+
+template <typename T>
+typename boost::disable_if<detail::is_parsable_number<T>, bool>::type parse_number(char const * begin, char const * end, T & value);
+
+//------------------------------------------------------------------------------------------------
+//              Implementation
+//------------------------------------------------------------------------------------------------
+
+template <typename T>
+typename boost::enable_if<detail::is_parsable_integer<T>, bool>::type parse_number(char const * begin, char const * end, T & value)
+{
+  typedef typename boost::make_unsigned<T>::type UnsignedT;
+
+  bool negative = false;
+  if (begin != end && (*begin == '-' || *begin == '+'))
+  {
+    negative = (*begin == '-');
+    ++begin;
+  }
+  if (begin == end || (negative && !boost::is_signed<T>::value))
+  {
+    return false;
+  }
+
+  //the magnitude of the most negative value is one larger than the maximum
+  UnsignedT const limit = static_cast<UnsignedT>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+  UnsignedT magnitude = 0;
+  for (; begin != end; ++begin)
+  {
+    unsigned int digit = static_cast<unsigned int>(*begin - '0');
+    if (digit > 9 || magnitude > (limit - digit)/10)
+    {
+      return false;
+    }
+    magnitude = magnitude*10 + digit;
+  }
+
+  value = negative ? static_cast<T>(UnsignedT(0) - magnitude) : static_cast<T>(magnitude);
+  return true;
+}
+
+template <typename T>
+typename boost::disable_if<detail::is_parsable_number<T>, bool>::type parse_number(char const * begin, char const * end, T & value)
+{
+  try
+  {
+    value = boost::lexical_cast<T>(begin, end - begin);
+    return true;
+  }
+  catch(boost::bad_lexical_cast const &)
+  {
+    return false;
+  }
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
+
+#endif
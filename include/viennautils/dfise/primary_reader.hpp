@@ -5,12 +5,16 @@
 
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
-#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/type_traits/is_same.hpp>
 #include <boost/utility/enable_if.hpp>
 
+#include "viennautils/dfise/block_index.hpp"
+#include "viennautils/dfise/input_source.hpp"
+#include "viennautils/dfise/number_parser.hpp"
 #include "viennautils/dfise/parsing_error.hpp"
 #include "viennautils/dfise/token_parser.hpp"
+#include "viennautils/dfise/token_pipeline.hpp"
 
 struct T;
 namespace viennautils
@@ -26,12 +30,15 @@ namespace dfise
  * .dat - dataset
  * .plt - plots
  * .pro - properties
+ *
+ * only the text variant (header: DF-ISE text) is supported, binary files (DF-ISE binary) are rejected
  */
 
 class primary_reader
 {
 public:
   typedef boost::function<void (primary_reader &)> ParsingFunc;
+  typedef boost::function<void (primary_reader &, std::size_t)> BlockFunc;
 
   enum filetype
   {
@@ -52,15 +59,60 @@ public:
     unsigned int nb_regions_;
   };
 
+  //read_mode_pipelined runs the parsing funcs while further tokens are read and converted by other threads
+  //access only matters for compressed content (see access_mode), the parsing funcs may only seek with random access
+  //  read_mode_pipelined and read_mode_parallel_blocks always use random access
   primary_reader( std::string const & filename
                 , ParsingFunc const & additional_info_parsing_func
                 , ParsingFunc const & data_block_parsing_func
+                , read_mode mode = read_mode_direct
+                , access_mode access = access_mode_sequential
+                );
+
+  //only reads the header and the Info block, single blocks within the Data block can be read afterwards by seeking
+  //to them (e.g. using offsets recorded by tell while skipping over the blocks, see dataset_file) - which requires
+  //random access, sequential access suffices if the reader is only used for the Info block (see peek)
+  primary_reader( std::string const & filename
+                , ParsingFunc const & additional_info_parsing_func
+                , access_mode access = access_mode_random
+                );
+
+  //same as above, but the content is taken from source (see input_source)
+  //  if source names a block index, skip_block and skip_to_block_end locate the blocks through it (given random access,
+  //  the index is not used while reading pipelined) - a missing or outdated index is built first by scanning the file
+  primary_reader( input_source const & source
+                , ParsingFunc const & additional_info_parsing_func
+                , ParsingFunc const & data_block_parsing_func
+                , read_mode mode = read_mode_direct
+                , access_mode access = access_mode_sequential
+                );
+
+  primary_reader( input_source const & source
+                , ParsingFunc const & additional_info_parsing_func
+                , access_mode access = access_mode_random
                 );
 
   mandatory_info const & get_mandatory_info() const {return mandatory_info_;}
+  //see token_parser::buffered_bytes
+  std::size_t get_buffered_bytes() const {return tp_.buffered_bytes();}
+
+  //byte offsets relative to the beginning of the file (seeking is neither possible while reading pipelined nor
+  //without random access)
+  void seek(std::size_t offset);
+  std::size_t tell() const {return pipeline_ ? pipeline_->tell() : tp_.tell();}
 
   template <typename T>
   void read_value(T & target);
+  //uses the value converted in advance when reading pipelined
+  void read_value(double & target);
+
+  //reads count values into target - with the exact same result as count calls of read_value
+  //  if OpenMP is enabled and the values make up the rest of the current block (as in Vertices or Values blocks),
+  //  large amounts of them are converted in parallel (in chunks split at line breaks) given random access
+  void read_values(double * target, std::size_t count);
+
+  //skips count integer values without converting them
+  void skip_values(std::size_t count);
 
   template <typename T>
   void read_attribute(std::string const & name, T & target);
@@ -73,22 +125,69 @@ public:
   template <typename T>
   void read_array(std::string const & name, std::vector<T> & target, typename std::vector<T>::size_type size);
 
+  //reads a block with a parameter, i.e. name(para) { ... }, and calls func(para) to parse its content
+  //  func can be anything callable (e.g. the result of boost::bind), since its type is known it can be inlined and no
+  //  boost::function has to be constructed for every block
+  template <typename Para, typename Handler>
+  void read_block(std::string const & name, Handler const & func);
+
+  //reads a block without a parameter, i.e. name { ... }, and calls func() to parse its content
+  template <typename Handler>
+  void read_block(std::string const & name, Handler const & func);
+
+  //compatibility overloads
   template <typename Para>
   void read_block(std::string const & name, boost::function<void (Para const &)> const & func);
 
   void read_block(std::string const & name, boost::function<void ()> const & func);
 
+  //skips a block (and its parameter, if any) without tokenizing or converting its content
+  //  blocks recorded in the block index are jumped over without scanning them at all
+  void skip_block(std::string const & name);
+
+  //skips the rest of the innermost indexed block around the current position, up to (but not including) its closing }
+  //  returns false (and does nothing) if there is no block index or no indexed block contains the current position
+  bool skip_to_block_end();
+
+  //reads count consecutive blocks of the given name by calling func(reader, i) for the i-th of them, func has to read
+  //the entire block from reader (e.g. using read_block)
+  //  with read_mode_parallel_blocks the blocks are located by skipping them first and then read concurrently (given
+  //  OpenMP) by readers of their own, func has to be thread-safe then - if blocks fail, the error of the first of them
+  //  (in file order) is thrown: parsing_error and std::bad_alloc as such, any other exception as std::runtime_error
+  //  with its message (func is never called twice for a block), if the pre-scan fails the blocks are read one after
+  //  another instead
+  //  otherwise func is called for one block after another with this reader
+  void read_blocks(std::string const & name, std::size_t count, BlockFunc const & func);
+
 private:
+  //a reader of the same content as other, positioned at offset (see read_blocks)
+  primary_reader(primary_reader const & other, std::size_t offset);
+
+  //loads (or builds and stores) the block index named by source, see input_source::file
+  void open_block_index(input_source const & source);
+  void parse_header(ParsingFunc const & additional_info_parsing_func);
   void parse_info_block(ParsingFunc const & additional_info_parsing_func);
+  void parse(ParsingFunc const & additional_info_parsing_func, ParsingFunc const & data_block_parsing_func, read_mode mode);
+  void parse_data(ParsingFunc const & data_block_parsing_func);
+
+  //take the tokens from the pipeline while there is one
+  token next_token() {return pipeline_ ? pipeline_->get_next() : tp_.get_next();}
+  void expect(std::string const & expected, std::string const & error_msg);
+
+  template <typename Handler>
+  void read_block_without_parameter(std::string const & name, Handler const & func);
 
   mandatory_info mandatory_info_;
   token_parser tp_;
+  token_pipeline * pipeline_;
+  read_mode mode_;
+  boost::shared_ptr<block_index const> index_; //shared with the readers of read_blocks
 
   template <typename T>
-  static typename boost::disable_if<boost::is_same<T, std::string>, T>::type convert_to(std::string const & str);
+  static typename boost::disable_if<boost::is_same<T, std::string>, T>::type convert_to(token const & tok);
 
   template <typename T>
-  static typename boost::enable_if<boost::is_same<T, std::string>, std::string>::type convert_to(std::string const & str);
+  static typename boost::enable_if<boost::is_same<T, std::string>, std::string>::type convert_to(token const & tok);
 };
 
 //------------------------------------------------------------------------------------------------
@@ -98,36 +197,36 @@ private:
 template <typename T>
 void primary_reader::read_value(T & target)
 {
-  target = convert_to<T>(tp_.get_next());
+  target = convert_to<T>(next_token());
 }
 
 template <typename T>
 void primary_reader::read_attribute(std::string const & name, T & target)
 {
-  tp_.expect(name, "attribute has invalid name");
-  tp_.expect("=", "attribute misses =");
+  expect(name, "attribute has invalid name");
+  expect("=", "attribute misses =");
   
-  target = convert_to<T>(tp_.get_next());
+  target = convert_to<T>(next_token());
 }
 
 template <typename T>
 void primary_reader::read_array(std::string const & name, std::vector<T> & target)
 {
-  tp_.expect(name, "array has invalid name");
-  tp_.expect("=", "attribute misses =");
+  expect(name, "array has invalid name");
+  expect("=", "attribute misses =");
   
-  tp_.expect("[", "attribute is not an array");
+  expect("[", "attribute is not an array");
   
   for (;;)
   {
-    std::string const & token = tp_.get_next();
-    if (token == "]")
+    token const tok = next_token();
+    if (tok == "]")
     {
       break;
     }
     else
     {
-      target.push_back(convert_to<T>(token));
+      target.push_back(convert_to<T>(tok));
     }
   }
 }
@@ -135,65 +234,81 @@ void primary_reader::read_array(std::string const & name, std::vector<T> & targe
 template <typename T>
 void primary_reader::read_array(std::string const & name, std::vector<T> & target, typename std::vector<T>::size_type size)
 {
-  tp_.expect(name, "array has invalid name");
-  tp_.expect("=", "attribute misses =");
+  expect(name, "array has invalid name");
+  expect("=", "attribute misses =");
   
-  tp_.expect("[", "attribute is not an array");
+  expect("[", "attribute is not an array");
   target.reserve(target.size() + size);
   for (typename std::vector<T>::size_type i = 0; i < size; ++i)
   {
-    target.push_back(convert_to<T>(tp_.get_next()));
+    target.push_back(convert_to<T>(next_token()));
   }
-  tp_.expect("]", "array did not end as expected");
+  expect("]", "array did not end as expected");
 }
 
-template <typename Para>
-void primary_reader::read_block(std::string const & name, boost::function<void (Para const & )> const & func)
+template <typename Para, typename Handler>
+void primary_reader::read_block(std::string const & name, Handler const & func)
 {
-  tp_.expect(name, "block has invalid name");
+  expect(name, "block has invalid name");
   
-  tp_.expect("(", "expected parameter parenthesis");
-  Para p = convert_to<Para>(tp_.get_next());
-  tp_.expect(")", "expected parameter to end");
+  expect("(", "expected parameter parenthesis");
+  Para p = convert_to<Para>(next_token());
+  expect(")", "expected parameter to end");
   
-  tp_.expect("{", "expected begin of block");
+  expect("{", "expected begin of block");
   func(p);
-  tp_.expect("}", "expected end of block");
+  expect("}", "expected end of block");
+}
+
+template <typename Handler>
+void primary_reader::read_block(std::string const & name, Handler const & func)
+{
+  read_block_without_parameter(name, func);
+}
+
+template <typename Para>
+void primary_reader::read_block(std::string const & name, boost::function<void (Para const & )> const & func)
+{
+  read_block<Para, boost::function<void (Para const &)> >(name, func);
+}
+
+template <typename Handler>
+void primary_reader::read_block_without_parameter(std::string const & name, Handler const & func)
+{
+  expect(name, "block has invalid name");
+  expect("{", "expected begin of block");
+  func();
+  expect("}", "expected end of block");
 }
 
 template <typename T>
-typename boost::disable_if<boost::is_same<T, std::string>, T>::type primary_reader::convert_to(std::string const & str)
+typename boost::disable_if<boost::is_same<T, std::string>, T>::type primary_reader::convert_to(token const & tok)
 {
-  try
+  T value;
+  if (!parse_number(tok.begin(), tok.end(), value))
   {
-    return boost::lexical_cast<T>(str);
-  }
-  catch(boost::bad_lexical_cast const &)
-  {
-    throw make_exception<parsing_error>("could not convert " + str + " to expected type");
+    throw make_exception<parsing_error>("could not convert " + tok.str() + " to expected type");
   }
+  return value;
 }
 
 
 template <typename T>
-typename boost::enable_if<boost::is_same<T, std::string>, std::string>::type primary_reader::convert_to(std::string const & str)
+typename boost::enable_if<boost::is_same<T, std::string>, std::string>::type primary_reader::convert_to(token const & tok)
 {
   //dfise regions/datasets/... can come in a quoted form i.e. "region_name"
   //those extra quotes are harmful in other formats, thus we strip them
-  if (str[0] == '"' || str[str.size()-1] == '"')
+  token::const_iterator begin = tok.begin();
+  token::const_iterator end = tok.end();
+  if (begin != end && *begin == '"')
   {
-    std::string tmp = str;
-    if (tmp[0] == '"')
-    {
-      tmp = tmp.erase(0,1);
-    }
-    if (tmp[tmp.size()-1] == '"')
-    {
-      tmp.erase(tmp.size()-1,1);
-    }
-    return tmp;
+    ++begin;
+  }
+  if (begin != end && *(end-1) == '"')
+  {
+    --end;
   }
-  return str;
+  return std::string(begin, end);
 }
 
 } //end of namespace dfise
@@ -0,0 +1,113 @@
+#ifndef VIENNAUTILS_DFISE_SNAPSHOT_HPP
+#define VIENNAUTILS_DFISE_SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+#include <cstring>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "viennautils/filesystem/mapped_file.hpp"
+
+namespace viennautils
+{
+namespace dfise
+{
+
+/* snapshots are binary images of the parsed contents of a DF-ISE file (see grd_bnd_reader and data_reader)
+ * the header stores format version, byte order, index width, size and modification time of the source file and a checksum
+ * of the payload, a snapshot is only used if all of them match - otherwise the text file has to be parsed again
+ *
+ * the payload is a sequence of 8 byte aligned items (integers, strings and arrays of plain values) so that it can be
+ * read straight from the memory mapped snapshot, arrays are copied with a single memcpy each
+ */
+enum snapshot_kind
+{
+  snapshot_kind_grid = 1,
+  snapshot_kind_dataset = 2
+};
+
+//default location of the snapshot of filename: <filename>.snapshot next to the file or, if a cache directory is given,
+//  a file in the cache directory whose name is derived from the (entire) path of filename
+std::string snapshot_path(std::string const & filename, std::string const & cache_directory = std::string());
+
+class snapshot_writer : boost::noncopyable
+{
+public:
+  //the snapshot is written to a temporary file first and only replaces snapshot_path in commit
+  //  throws a parsing_error if the source file or the snapshot cannot be accessed
+  snapshot_writer(std::string const & snapshot_path, std::string const & filename, snapshot_kind kind);
+  ~snapshot_writer();
+
+  void write(boost::uint64_t value);
+  void write(std::string const & value);
+  void write(std::vector<std::string> const & values);
+
+  template <typename T>
+  void write(std::vector<T> const & values)
+  {
+    write(static_cast<boost::uint64_t>(values.size()));
+    if (!values.empty())
+    {
+      write_bytes(reinterpret_cast<char const*>(&values[0]), values.size()*sizeof(T));
+    }
+  }
+
+  void commit();
+
+private:
+  void write_bytes(char const * data, std::size_t size);
+
+  std::string snapshot_path_;
+  std::string temporary_path_;
+  std::ofstream stream_;
+  boost::uint64_t payload_size_;
+  boost::uint64_t checksum_;
+  bool committed_;
+};
+
+class snapshot_reader : boost::noncopyable
+{
+public:
+  snapshot_reader() : position_(0), end_(0) {}
+
+  //returns false if there is no valid, up to date snapshot of the given kind for filename
+  bool open(std::string const & snapshot_path, std::string const & filename, snapshot_kind kind);
+
+  //all read functions return false if the snapshot ends prematurely
+  bool read(boost::uint64_t & value);
+  bool read(std::string & value);
+  bool read(std::vector<std::string> & values);
+
+  template <typename T>
+  bool read(std::vector<T> & values)
+  {
+    boost::uint64_t size;
+    if (!read(size) || size > static_cast<boost::uint64_t>(end_ - position_)/sizeof(T))
+    {
+      return false;
+    }
+    values.resize(static_cast<std::size_t>(size));
+    if (size != 0)
+    {
+      std::memcpy(&values[0], position_, values.size()*sizeof(T));
+    }
+    return skip(values.size()*sizeof(T));
+  }
+
+private:
+  bool skip(std::size_t size);
+
+  viennautils::filesystem::mapped_file file_;
+  char const * position_;
+  char const * end_;
+};
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
+
+#endif
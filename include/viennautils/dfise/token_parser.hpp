@@ -3,28 +3,143 @@
 
 #include <string>
 #include <vector>
-#include <fstream>
+#include <cstring>
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/smart_ptr/scoped_ptr.hpp>
+
+#include "viennautils/filesystem/mapped_file.hpp"
+#include "viennautils/dfise/input_source.hpp"
+#include "viennautils/dfise/decompression.hpp"
 
 namespace viennautils
 {
 namespace dfise
 {
 
-class token_parser
+/* token is a non-owning view of a range of characters within the file that is currently being parsed
+ * it stays valid as long as the token_parser that produced it (with sequential access to compressed content only until
+ * the next token is read, see access_mode)
+ */
+class token
+{
+public:
+  typedef char const* const_iterator;
+  typedef std::size_t size_type;
+
+  token() : begin_(0), end_(0) {}
+  token(const_iterator begin, const_iterator end) : begin_(begin), end_(end) {}
+
+  const_iterator begin() const {return begin_;}
+  const_iterator end()   const {return end_;}
+  size_type      size()  const {return static_cast<size_type>(end_ - begin_);}
+  bool           empty() const {return begin_ == end_;}
+  char operator[](size_type i) const {return begin_[i];}
+
+  std::string str() const {return std::string(begin_, end_);}
+
+private:
+  const_iterator begin_;
+  const_iterator end_;
+};
+
+inline bool operator==(token const & lhs, char const * rhs)
+{
+  std::size_t length = std::strlen(rhs);
+  return lhs.size() == length && std::memcmp(lhs.begin(), rhs, length) == 0;
+}
+
+inline bool operator==(token const & lhs, std::string const & rhs)
+{
+  return lhs.size() == rhs.size() && std::memcmp(lhs.begin(), rhs.data(), rhs.size()) == 0;
+}
+
+inline bool operator!=(token const & lhs, char const * rhs)        {return !(lhs == rhs);}
+inline bool operator!=(token const & lhs, std::string const & rhs) {return !(lhs == rhs);}
+
+//compressed content is either decompressed as a whole when opening it (random access, i.e. seek, data and size work
+//just like for uncompressed content) or piece by piece through a window of bounded size while it is parsed
+//(sequential access, needs far less memory but allows neither seeking nor data and size), uncompressed content always
+//allows random access
+enum access_mode
+{
+  access_mode_random,
+  access_mode_sequential
+};
+
+/* token_parser splits a memory mapped file into tokens
+ * no line buffers or per-token strings are created, tokens merely point into the mapping
+ * the file is classified in windows of 64 bytes at once (using SSE2/AVX2 if available) into bitmasks of whitespace and
+ * token delimiting characters, token boundaries are then found by bit scanning instead of inspecting every single char
+ * define VIENNAUTILS_DFISE_NO_SIMD to use the portable (table based) classification instead
+ * the content can come from any input_source, compressed content (see decompression.hpp) is decompressed according to
+ * the access_mode - a sequential window always ends after a line break, thus only quoted strings and skipped blocks
+ * continue in the next window
+ */
+class token_parser : boost::noncopyable
 {
 public:
-  explicit token_parser(std::string const & filename);
+  explicit token_parser(std::string const & filename, access_mode access = access_mode_random);
+  explicit token_parser(input_source const & source, access_mode access = access_mode_random);
+  //tokenizes a range of memory owned by someone else (e.g. a part of a block of another token_parser)
+  token_parser(char const* begin, char const* end);
 
   bool at_end() const;
-  std::string const& get_next();
+  //skips whitespaces and comments, returns false if no further token follows
+  bool has_next();
+  token get_next();
   void expect(std::string const & expected, std::string const & error_msg);
 
-private:
-  typedef std::vector<std::string> Components;
+  //skips the remainder of a block whose opening { was just read - including the matching }
+  //the content is not tokenized, only braces, comments and quoted strings are tracked
+  //  the chars in between are jumped over by a scan that uses SSE2/AVX2 just like the classification of the tokenizer
+  void skip_block();
+
+  //false if compressed content is read sequentially (see access_mode)
+  bool random_access() const {return !decompressor_;}
 
-  std::ifstream file_;
-  Components normalized_line_;
-  Components::iterator current_;
+  //byte offsets relative to the beginning of the file (or range), seeking requires random access
+  std::size_t tell() const {return offset_ + (current_ - begin_);}
+  std::size_t offset_of(token const & tok) const {return offset_ + (tok.begin() - begin_);}
+  void seek(std::size_t offset);
+
+  //the entire file (or range) that is being tokenized, requires random access
+  char const* data() const {return begin_;}
+  std::size_t size() const {return end_ - begin_;}
+  //heap memory holding the content (streams and compressed files only, files are memory mapped)
+  std::size_t buffered_bytes() const {return buffer_.capacity() + compressed_.capacity();}
+
+private:
+  typedef boost::uint64_t Mask;
+  static std::size_t const window_size = 64;
+
+  void open(input_source const & source, access_mode access);
+  //sequential access only: discards the content before current_, appends further content to the window and moves
+  //current_ to the beginning of the window, returns false if the window could not be extended
+  bool refill();
+  void load_window(char const* window);
+  char const* skip_whitespace(char const* pos);
+  char const* find_token_end(char const* pos);
+
+  viennautils::filesystem::mapped_file file_;
+  std::vector<char> buffer_; //content of streams and decompressed content (the window with sequential access)
+  char const* begin_;
+  char const* current_;
+  char const* end_;
+
+  //sequential access only: the window [begin_, end_) is followed by content that is decompressed already but does not
+  //end with a line break yet, up to content_end_
+  boost::scoped_ptr<decompressor> decompressor_;
+  std::vector<char> compressed_; //compressed content of streams
+  char const* content_end_;
+  std::size_t offset_;           //of begin_ within the content
+
+  //bit i of the masks corresponds to window_[i], bytes past the end of the file are marked in both masks
+  char const* window_;
+  Mask        whitespace_mask_;
+  Mask        token_end_mask_;
 
   static bool is_whitespace(char c);
   static bool is_standalone(char c);
@@ -0,0 +1,101 @@
+#ifndef VIENNAUTILS_DFISE_TOKEN_PIPELINE_HPP
+#define VIENNAUTILS_DFISE_TOKEN_PIPELINE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "viennautils/dfise/token_parser.hpp"
+
+namespace viennautils
+{
+namespace dfise
+{
+
+enum read_mode
+{
+  read_mode_direct,         //tokenizing, conversion and parsing all happen on the calling thread
+  read_mode_pipelined,      //see token_pipeline
+  read_mode_parallel_blocks //read directly, but sibling blocks (Region, Dataset) are parsed concurrently (see primary_reader::read_blocks)
+};
+
+/* token_pipeline splits reading a file into stages that run concurrently (given OpenMP and enough threads):
+ *  - a prefetching stage that touches the pages of the mapped file ahead of the tokenizer, so that disk reads (on cold
+ *    caches) overlap with the other stages
+ *  - a tokenizing stage that fills batches of tokens
+ *  - a conversion stage that converts the numeric tokens of every batch to double in advance
+ *  - the consumer, i.e. the calling thread that runs the actual parsing (the callbacks of the readers)
+ * the stages are connected by a bounded ring of batches which every batch passes in stage order, each pair of
+ * neighbouring stages thus forms a single-producer/single-consumer queue
+ * every stage gets a thread of its own as far as omp_get_max_threads allows (two threads are used at least), stages that
+ * do not get a thread are carried out by the preceding stage (or the consumer)
+ */
+class token_pipeline : boost::noncopyable
+{
+public:
+  //the tokens are taken from the current position of tp onwards
+  explicit token_pipeline(token_parser & tp);
+
+  //runs func on the calling thread while the other stages run concurrently, returns after all stages stopped
+  //exceptions thrown by func are passed on (parsing_errors and std::bad_alloc as such, anything else as std::runtime_error)
+  void run(boost::function<void ()> const & func);
+
+  //same semantics as the corresponding functions of token_parser, may only be called from within func
+  token get_next();
+  void expect(std::string const & expected, std::string const & error_msg);
+  void skip_block();
+  std::size_t tell() const;
+
+  //the value of the token that was returned by the last get_next, returns false if it is not a number
+  bool get_number(double & value) const {return current_->is_number_[index_-1] && (value = current_->numbers_[index_-1], true);}
+
+private:
+  static std::size_t const batch_size = 4096;
+  static std::size_t const ring_size = 16;
+
+  struct batch
+  {
+    token       tokens_[batch_size];
+    double      numbers_[batch_size];
+    bool        is_number_[batch_size];
+    std::size_t count_;
+    bool        last_;  //no further batches follow
+    std::string error_; //error the tokenizer ran into after the tokens of this (last) batch, if any
+  };
+
+  void tokenize_stage(bool convert);
+  void convert_stage();
+  void prefetch_stage();
+
+  void tokenize_batch(batch & b);
+  static void convert_batch(batch & b);
+  void next_batch();
+
+  token_parser & tp_;
+  std::size_t begin_offset_;
+  std::vector<batch> ring_;
+
+  //number of batches that passed the respective stage, only written by that stage
+  //  they are shared between the stages, hence only accessed atomically (see load and store in token_pipeline.cpp)
+  std::size_t tokenized_;
+  std::size_t converted_;
+  std::size_t consumed_;
+  std::size_t tokenizer_offset_;
+  bool stop_;
+  unsigned char prefetched_; //sum of the bytes touched by the prefetching stage, keeps the reads from being optimized away
+
+  //consumer state
+  bool inline_; //no other threads, the consumer has to tokenize and convert on its own
+  batch * current_;
+  std::size_t batch_number_;
+  std::size_t index_;
+};
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
+
+#endif
@@ -2,6 +2,9 @@
 #define VIENNAUTILS_FILESYSTEM_FILESYSTEM_HPP
 
 #include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
 
 namespace viennautils
 {
@@ -13,6 +16,19 @@ std::string extract_stem(std::string const & path);
 std::string extract_filename(std::string const & path);
 std::string extract_path(std::string const & path, bool include_last_delimiter = false);
 
+//returns false if the file does not exist (or cannot be accessed), modification time is given in nanoseconds since epoch
+//  (as precise as the file system records it, which is why it is not given in seconds)
+bool get_file_status(std::string const & path, boost::uint64_t & size, boost::int64_t & modification_time);
+
+//a path next to path for a file that is written first and renamed to path afterwards, it is unique for every call and
+//  contains the process id, so concurrent writers (processes or threads) of the same file do not share it
+std::string temporary_path(std::string const & path);
+
+//adds the paths of all regular files within directory and its subdirectories to files (in no particular order)
+//  symbolic links to directories are not followed, subdirectories that cannot be opened are skipped
+//  returns false if directory itself cannot be opened
+bool list_files_recursively(std::string const & directory, std::vector<std::string> & files);
+
 } //end of namespace filesystem
 } //end of namespace viennautils
 
@@ -0,0 +1,60 @@
+#ifndef VIENNAUTILS_FILESYSTEM_MAPPED_FILE_HPP
+#define VIENNAUTILS_FILESYSTEM_MAPPED_FILE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+
+namespace viennautils
+{
+namespace filesystem
+{
+
+/* mapped_file provides read-only access to the entire contents of a file as one contiguous block of memory
+ * the file is memory mapped if possible, otherwise (e.g. for pipes or special files) it is read into a heap buffer
+ * (in large chunks directly into the buffer)
+ * the memory stays valid until the mapped_file is closed or destroyed
+ */
+class mapped_file : boost::noncopyable
+{
+public:
+  mapped_file();
+  explicit mapped_file(std::string const & path);
+  ~mapped_file();
+
+  //returns false if the file could not be opened
+  bool open(std::string const & path);
+  //the descriptor is neither closed nor needed afterwards, regular files are mapped as a whole (regardless of the current
+  //position of the descriptor), anything else is read from the current position up to its end
+  //returns false if reading fails
+  bool open(int descriptor);
+  void close();
+
+  bool        is_open() const {return is_open_;}
+  char const* data()    const {return data_;}
+  std::size_t size()    const {return size_;}
+
+private:
+  bool read_into_buffer(std::string const & path);
+  bool read_into_buffer(int descriptor);
+#ifndef _WIN32
+  bool map(int descriptor, std::size_t size);
+#endif
+
+  bool              is_open_;
+  char const*       data_;
+  std::size_t       size_;
+  void*             mapping_;
+  std::vector<char> buffer_;
+#ifdef _WIN32
+  void*             file_handle_;
+  void*             mapping_handle_;
+#endif
+};
+
+} //end of namespace filesystem
+} //end of namespace viennautils
+
+#endif
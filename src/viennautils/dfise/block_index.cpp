@@ -0,0 +1,294 @@
+#include "viennautils/dfise/block_index.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+
+#include "viennautils/filesystem/filesystem.hpp"
+#include "viennautils/dfise/parsing_error.hpp"
+#include "viennautils/dfise/token_parser.hpp"
+
+namespace viennautils
+{
+namespace dfise
+{
+
+namespace
+{
+
+char const index_magic[8] = {'D', 'F', 'I', 'S', 'E', 'I', 'D', 'X'};
+boost::uint32_t const index_version = 2;
+boost::uint32_t const byte_order_mark = 0x01020304;
+
+std::string strip_quotes(token const & tok)
+{
+  token::const_iterator begin = tok.begin();
+  token::const_iterator end = tok.end();
+  if (begin != end && *begin == '"')
+  {
+    ++begin;
+  }
+  if (begin != end && *(end-1) == '"')
+  {
+    --end;
+  }
+  return std::string(begin, end);
+}
+
+template <typename T>
+void write_binary(std::ostream & stream, T const & value)
+{
+  stream.write(reinterpret_cast<char const*>(&value), sizeof(T));
+}
+
+void write_binary(std::ostream & stream, std::string const & value)
+{
+  write_binary(stream, static_cast<boost::uint32_t>(value.size()));
+  stream.write(value.data(), value.size());
+}
+
+template <typename T>
+bool read_binary(std::istream & stream, T & value)
+{
+  return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+bool read_binary(std::istream & stream, std::string & value)
+{
+  boost::uint32_t size;
+  if (!read_binary(stream, size) || size > (1u << 20))
+  {
+    return false;
+  }
+  value.resize(size);
+  return size == 0 || static_cast<bool>(stream.read(&value[0], size));
+}
+
+//reads the optional parameter of a block as well as its opening brace
+//  the block name and the token following it have already been read
+void read_block_header(token_parser & tp, token const & name, token next, block_index::entry & e)
+{
+  e.name_ = name.str();
+  e.offset_ = tp.offset_of(name);
+  if (next == "(")
+  {
+    e.parameter_ = strip_quotes(tp.get_next());
+    tp.expect(")", "expected parameter to end");
+    next = tp.get_next();
+  }
+  if (next != "{")
+  {
+    throw make_exception<parsing_error>("expected begin of block " + e.name_ + " got: " + next.str());
+  }
+}
+
+bool offset_less(block_index::entry const & e, std::size_t offset)
+{
+  return e.offset_ < offset;
+}
+
+bool offset_greater(std::size_t offset, block_index::entry const & e)
+{
+  return offset < e.offset_;
+}
+
+} //end of anonymous namespace
+
+void block_index::build(token_parser & tp)
+{
+  entries_.clear();
+  
+  tp.seek(0);
+  tp.expect("DF-ISE", "invalid/unsupported file header");
+  tp.get_next(); //file format
+  
+  while (tp.has_next())
+  {
+    entry top_level;
+    top_level.level_ = 0;
+    token name = tp.get_next();
+    read_block_header(tp, name, tp.get_next(), top_level);
+    EntryVector::size_type top_level_index = entries_.size();
+    entries_.push_back(top_level);
+  
+    for (;;)
+    {
+      token tok = tp.get_next();
+      if (tok == "}")
+      {
+        break;
+      }
+  
+      token next = tp.get_next();
+      if (next == "=")
+      {
+        //attributes are skipped, arrays included
+        if (tp.get_next() == "[")
+        {
+          while (tp.get_next() != "]");
+        }
+        continue;
+      }
+  
+      entry second_level;
+      second_level.level_ = 1;
+      read_block_header(tp, tok, next, second_level);
+      tp.skip_block();
+      second_level.length_ = tp.tell() - second_level.offset_;
+      entries_.push_back(second_level);
+    }
+  
+    entries_[top_level_index].length_ = tp.tell() - entries_[top_level_index].offset_;
+  }
+}
+
+bool block_index::load(std::string const & index_path, std::string const & filename)
+{
+  boost::uint64_t file_size;
+  boost::int64_t modification_time;
+  if (!viennautils::filesystem::get_file_status(filename, file_size, modification_time))
+  {
+    return false;
+  }
+  
+  std::ifstream stream(index_path.c_str(), std::ios::in | std::ios::binary);
+  char magic[sizeof(index_magic)];
+  boost::uint32_t version;
+  boost::uint32_t byte_order;
+  boost::uint64_t indexed_size;
+  boost::int64_t indexed_modification_time;
+  std::string indexed_filename;
+  boost::uint64_t count;
+  if (  !stream.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), index_magic)
+     || !read_binary(stream, version) || version != index_version
+     || !read_binary(stream, byte_order) || byte_order != byte_order_mark
+     || !read_binary(stream, indexed_size) || indexed_size != file_size
+     || !read_binary(stream, indexed_modification_time) || indexed_modification_time != modification_time
+     //the index is only valid for the very same path
+     || !read_binary(stream, indexed_filename) || indexed_filename != filename
+     || !read_binary(stream, count)
+     )
+  {
+    return false;
+  }
+  
+  EntryVector entries;
+  for (boost::uint64_t i = 0; i < count; ++i)
+  {
+    entry e;
+    boost::uint32_t level;
+    boost::uint64_t offset;
+    boost::uint64_t length;
+    if (  !read_binary(stream, e.name_) || !read_binary(stream, e.parameter_)
+       || !read_binary(stream, level) || !read_binary(stream, offset) || !read_binary(stream, length)
+       //the entries are looked up by offset (see find_at)
+       || (!entries.empty() && offset <= entries.back().offset_)
+       )
+    {
+      return false;
+    }
+    e.level_ = level;
+    e.offset_ = static_cast<std::size_t>(offset);
+    e.length_ = static_cast<std::size_t>(length);
+    entries.push_back(e);
+  }
+  
+  entries_.swap(entries);
+  return true;
+}
+
+void block_index::save(std::string const & index_path, std::string const & filename) const
+{
+  boost::uint64_t file_size;
+  boost::int64_t modification_time;
+  if (!viennautils::filesystem::get_file_status(filename, file_size, modification_time))
+  {
+    throw make_exception<parsing_error>("cannot access file " + filename);
+  }
+  
+  std::string temporary_path = viennautils::filesystem::temporary_path(index_path);
+  {
+    std::ofstream stream(temporary_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    stream.write(index_magic, sizeof(index_magic));
+    write_binary(stream, index_version);
+    write_binary(stream, byte_order_mark);
+    write_binary(stream, file_size);
+    write_binary(stream, modification_time);
+    write_binary(stream, filename);
+    write_binary(stream, static_cast<boost::uint64_t>(entries_.size()));
+    for (EntryVector::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+    {
+      write_binary(stream, it->name_);
+      write_binary(stream, it->parameter_);
+      write_binary(stream, static_cast<boost::uint32_t>(it->level_));
+      write_binary(stream, static_cast<boost::uint64_t>(it->offset_));
+      write_binary(stream, static_cast<boost::uint64_t>(it->length_));
+    }
+    stream.close();
+    if (!stream)
+    {
+      std::remove(temporary_path.c_str());
+      throw make_exception<parsing_error>("cannot write block index " + index_path);
+    }
+  }
+  
+  //rename does not replace existing files on every platform
+  if (std::rename(temporary_path.c_str(), index_path.c_str()) != 0)
+  {
+    std::remove(index_path.c_str());
+    if (std::rename(temporary_path.c_str(), index_path.c_str()) != 0)
+    {
+      std::remove(temporary_path.c_str());
+      throw make_exception<parsing_error>("cannot write block index " + index_path);
+    }
+  }
+}
+
+block_index::entry const * block_index::find(std::string const & name) const
+{
+  for (EntryVector::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+  {
+    if (it->name_ == name)
+    {
+      return &*it;
+    }
+  }
+  return 0;
+}
+
+block_index::entry const * block_index::find(std::string const & name, std::string const & parameter) const
+{
+  for (EntryVector::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+  {
+    if (it->name_ == name && it->parameter_ == parameter)
+    {
+      return &*it;
+    }
+  }
+  return 0;
+}
+
+block_index::entry const * block_index::find_at(std::size_t offset) const
+{
+  EntryVector::const_iterator it = std::lower_bound(entries_.begin(), entries_.end(), offset, offset_less);
+  return (it != entries_.end() && it->offset_ == offset) ? &*it : 0;
+}
+
+block_index::entry const * block_index::find_enclosing(std::size_t offset) const
+{
+  //blocks are recorded before the blocks within them, thus the innermost one is the last one that contains offset
+  EntryVector::const_iterator it = std::upper_bound(entries_.begin(), entries_.end(), offset, offset_greater);
+  while (it != entries_.begin())
+  {
+    --it;
+    if (it->offset_ < offset && offset < it->offset_ + it->length_)
+    {
+      return &*it;
+    }
+  }
+  return 0;
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
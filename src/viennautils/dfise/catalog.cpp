@@ -0,0 +1,109 @@
+#include "viennautils/dfise/catalog.hpp"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
+#include "viennautils/filesystem/filesystem.hpp"
+#include "viennautils/dfise/decompression.hpp"
+#include "viennautils/dfise/parsing_error.hpp"
+
+namespace viennautils
+{
+namespace dfise
+{
+
+namespace
+{
+
+//the rest of the Info block, depending on the file type
+void parse_additional_info(primary_reader & preader, file_info & info)
+{
+  if (preader.get_mandatory_info().type_ == primary_reader::filetype_dataset)
+  {
+    preader.read_array("datasets", info.datasets_);
+    preader.read_array("functions", info.functions_);
+  }
+  else
+  {
+    preader.read_array("regions", info.regions_);
+    preader.read_array("materials", info.materials_);
+  }
+}
+
+bool is_dfise_file(std::string const & path)
+{
+  std::string extension = viennautils::filesystem::extract_extension(strip_compression_extension(path));
+  return extension == "grd" || extension == "bnd" || extension == "dat";
+}
+
+} //end of anonymous namespace
+
+file_info peek(std::string const & filepath)
+{
+  file_info info;
+  info.filepath_ = filepath;
+  try
+  {
+    primary_reader preader(filepath, boost::bind(parse_additional_info, _1, boost::ref(info)), access_mode_sequential);
+    info.mandatory_info_ = preader.get_mandatory_info();
+  }
+  catch(parsing_error const & e)
+  {
+    throw make_exception<parsing_error>("while parsing file: " + filepath + " - " + e.what());
+  }
+  return info;
+}
+
+catalog build_catalog(std::string const & directory)
+{
+  std::vector<std::string> paths;
+  if (!viennautils::filesystem::list_files_recursively(directory, paths))
+  {
+    throw make_exception<parsing_error>("cannot open directory " + directory);
+  }
+  paths.erase(std::remove_if(paths.begin(), paths.end(), !boost::bind(is_dfise_file, _1)), paths.end());
+  std::sort(paths.begin(), paths.end());
+
+  //every file is peeked at independently, exceptions must not leave the parallel region
+  std::vector<file_info> infos(paths.size());
+  std::vector<std::string> errors(paths.size());
+  long const count = static_cast<long>(paths.size());
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (long i = 0; i < count; ++i)
+  {
+    try
+    {
+      infos[i] = peek(paths[i]);
+    }
+    catch (std::exception const & e)
+    {
+      //an empty message would mark the file as peeked successfully
+      errors[i] = *e.what() ? e.what() : "unknown error while peeking at the file";
+    }
+    catch (...)
+    {
+      errors[i] = "unknown error while peeking at the file";
+    }
+  }
+
+  catalog result;
+  result.files_.reserve(paths.size());
+  for (std::size_t i = 0; i < paths.size(); ++i)
+  {
+    if (errors[i].empty())
+    {
+      result.files_.push_back(infos[i]);
+    }
+    else
+    {
+      result.errors_.push_back(std::make_pair(paths[i], errors[i]));
+    }
+  }
+  return result;
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
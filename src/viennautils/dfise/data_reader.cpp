@@ -1,11 +1,19 @@
 #include "viennautils/dfise/data_reader.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <new>
+#include <stdexcept>
+
 #include <boost/ref.hpp>
 #include <boost/bind.hpp>
 
 #include "viennautils/filesystem/filesystem.hpp"
+#include "viennautils/dfise/decompression.hpp"
 #include "viennautils/dfise/parsing_error.hpp"
 #include "viennautils/dfise/primary_reader.hpp"
+#include "viennautils/dfise/snapshot.hpp"
 
 namespace viennautils
 {
@@ -25,8 +33,96 @@ void expect(primary_reader & preader, std::string const & attribute_name, std::s
   }
 }
 
+//collects the sorted (and unique) indices of all vertices of the region's elements
+//  inserting them into the flat_set one by one would be quadratic, instead they are gathered and sorted - or marked in
+//  a bitmap over all vertices if the region references a large share of them
+void collect_region_vertices(grd_bnd_reader const & gbreader, grd_bnd_reader::region const & region, std::vector<grd_bnd_reader::VertexIndex> & vertices)
+{
+  grd_bnd_reader::element_connectivity const & elements = gbreader.get_element_connectivity();
+  std::vector<grd_bnd_reader::ElementIndex> const & element_indices = region.element_indices_;
+  grd_bnd_reader::VertexIndex vertex_count = gbreader.get_vertices().size()/gbreader.get_dimension();
+  
+  std::size_t reference_count = 0;
+  for (std::size_t i = 0; i < element_indices.size(); ++i)
+  {
+    //indices in greader are guaranteed to be valid (not out of bounds)
+    reference_count += elements.vertex_count(element_indices[i]);
+  }
+  
+  vertices.clear();
+  if (reference_count >= vertex_count/16)
+  {
+    std::vector<bool> is_region_vertex(vertex_count, false);
+    for (std::size_t i = 0; i < element_indices.size(); ++i)
+    {
+      grd_bnd_reader::element_connectivity::VertexIterator it = elements.vertices_begin(element_indices[i]);
+      grd_bnd_reader::element_connectivity::VertexIterator end = elements.vertices_end(element_indices[i]);
+      for (; it != end; ++it)
+      {
+        is_region_vertex[*it] = true;
+      }
+    }
+    for (grd_bnd_reader::VertexIndex vertex = 0; vertex < vertex_count; ++vertex)
+    {
+      if (is_region_vertex[vertex])
+      {
+        vertices.push_back(vertex);
+      }
+    }
+  }
+  else
+  {
+    vertices.reserve(reference_count);
+    for (std::size_t i = 0; i < element_indices.size(); ++i)
+    {
+      vertices.insert(vertices.end(), elements.vertices_begin(element_indices[i]), elements.vertices_end(element_indices[i]));
+    }
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+  }
+}
+
+void check_value_count(std::size_t expected, std::size_t got)
+{
+  if (expected != got)
+  {
+    throw make_exception<parsing_error>( "invalid number of values, expected: " + boost::lexical_cast<std::string>(expected)
+                                       + ", got: " + boost::lexical_cast<std::string>(got)
+                                       );
+  }
+}
+
+//adds the sorted (and unique) vertices [begin, end) to the sorted (and unique) target
+void merge_into(data_reader::VertexIndexVector & target, grd_bnd_reader::VertexIndex const * begin, grd_bnd_reader::VertexIndex const * end)
+{
+  data_reader::VertexIndexVector merged;
+  merged.reserve(target.size() + (end - begin));
+  std::set_union(target.begin(), target.end(), begin, end, std::back_inserter(merged));
+  target.swap(merged);
+}
+
 } //end of anonyomous namespace
 
+void dataset_buffer_sink::begin_block( std::string const & dataset_name, unsigned int dimension
+                                     , std::vector<std::string> const & /*validity*/, std::size_t /*vertex_count*/
+                                     )
+{
+  if (dimension != dimension_)
+  {
+    throw make_exception<parsing_error>( "dimension of dataset: " + dataset_name + " (" + boost::lexical_cast<std::string>(dimension)
+                                       + ") does not match the buffer (" + boost::lexical_cast<std::string>(dimension_) + ")"
+                                       );
+  }
+}
+
+void dataset_buffer_sink::consume(VertexIndex const * vertices, double const * values, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    std::copy(values + i*dimension_, values + (i+1)*dimension_, buffer_ + static_cast<std::size_t>(vertices[i])*dimension_);
+  }
+}
+
 struct data_reader::Dataset
 {
   std::string name_;
@@ -37,169 +133,564 @@ struct data_reader::Dataset
 };
 
 data_reader::data_reader( grd_bnd_reader const & gbreader
+                        , read_mode mode
                         )
-                        : dimension_(gbreader.get_dimension())
+                        : read_mode_(mode)
+                        , dimension_(gbreader.get_dimension())
                         , vertex_count_(gbreader.get_vertices().size()/dimension_)
-                        , element_count_(gbreader.get_elements().size())
+                        , file_vertex_count_(gbreader.get_vertex_map().empty() ? vertex_count_ : gbreader.get_vertex_map().size())
+                        , element_count_(gbreader.get_element_map().empty() ? gbreader.get_element_connectivity().size() : gbreader.get_element_map().size())
+                        , file_region_count_(gbreader.get_regions().size() + gbreader.get_skipped_regions().size())
+                        , skipped_regions_(gbreader.get_skipped_regions().begin(), gbreader.get_skipped_regions().end())
+                        , peak_bytes_(0)
 {
+  if (!skipped_regions_.empty())
+  {
+    vertex_map_ = gbreader.get_vertex_map();
+  }
+  
   //find and sort all vertices of every region
   //this is actually redundant information, however it will be needed often when reading additional dataset files
+  //the map entries are created first, since regions are independent they can then be filled in parallel
+  std::vector<grd_bnd_reader::region const *> regions;
+  std::vector<VertexIndexSet *> region_vertices;
   region_vertex_indices_.reserve(gbreader.get_regions().size());
   for (grd_bnd_reader::RegionMap::const_iterator region_it = gbreader.get_regions().begin(); region_it != gbreader.get_regions().end(); ++region_it)
   {
-    VertexIndexSet & region_vertices = region_vertex_indices_[region_it->first];
-    for ( std::vector<grd_bnd_reader::ElementIndex>::const_iterator element_it = region_it->second.element_indices_.begin()
-        ; element_it != region_it->second.element_indices_.end()
-        ; ++element_it
-        )
-    {
-      //indices in greader are guaranteed to be valid (not out of bounds)
-      grd_bnd_reader::element const & element = gbreader.get_elements()[*element_it];
-      for ( std::vector<grd_bnd_reader::VertexIndex>::const_iterator vertex_it = element.vertex_indices_.begin()
-          ; vertex_it != element.vertex_indices_.end()
-          ; ++vertex_it
-          )
-      {
-        region_vertices.insert(*vertex_it);
-      }
-    }
+    region_vertex_indices_[region_it->first];
+  }
+  for (grd_bnd_reader::RegionMap::const_iterator region_it = gbreader.get_regions().begin(); region_it != gbreader.get_regions().end(); ++region_it)
+  {
+    regions.push_back(&region_it->second);
+    region_vertices.push_back(&region_vertex_indices_[region_it->first]);
   }
+  
+  #pragma omp parallel for schedule(dynamic)
+  for (long i = 0; i < static_cast<long>(regions.size()); ++i)
+  {
+    std::vector<grd_bnd_reader::VertexIndex> vertices;
+    collect_region_vertices(gbreader, *regions[i], vertices);
+    VertexIndexSet(boost::container::ordered_unique_range, vertices.begin(), vertices.end()).swap(*region_vertices[i]);
+  }
+  update_peak_bytes(0);
 }
 
 void data_reader::read(std::string const & filepath)
+{
+  read(input_source::file(filepath));
+}
+
+void data_reader::read(input_source const & source)
 {
   try
   {
     //start by reading all datasets in the file using the primary_reader
     DatasetList datasets;
-    primary_reader preader( filepath
-                          , boost::bind(&data_reader::parse_additional_info, this, _1, boost::ref(datasets))
-                          , boost::bind(&data_reader::parse_data_block, this, _1, boost::ref(datasets))
-                          );
+    update_peak_bytes(parse(source, datasets));
+    remove_streamed_datasets(datasets);
     
-    while (!datasets.empty())
+    unify_datasets(datasets, source.get_name());
+    update_peak_bytes(0);
+  }
+  catch(parsing_error const & e)
+  {
+    throw make_exception<parsing_error>("while parsing file: " + source.get_name() + " - " + e.what());
+  }
+}
+
+void data_reader::read(std::string const & filepath, std::string const & snapshot_path)
+{
+  try
+  {
+    //the snapshot holds the datasets of the file as they are before unification
+    DatasetList datasets;
+    bool restored = false;
     {
-      std::string const & dataset_name = datasets.begin()->name_;
-      try
+      snapshot_reader sreader;
+      restored = sreader.open(snapshot_path, filepath, snapshot_kind_dataset) && load_snapshot(sreader, datasets);
+    }
+    
+    if (restored)
+    {
+      update_peak_bytes(dataset_bytes(datasets));
+      stream_restored_datasets(datasets);
+    }
+    else
+    {
+      datasets.clear();
+      update_peak_bytes(parse(input_source::file(filepath), datasets));
+      
+      //the values of streamed datasets are gone, such a snapshot would be incomplete (as would be one without the
+      //datasets of skipped regions)
+      //failing to write the snapshot (e.g. in a read-only directory) is not an error, the file just has to be parsed again next time
+      if (!remove_streamed_datasets(datasets) && skipped_regions_.empty())
       {
-        std::vector<DatasetList::iterator> subset;
-        boost::container::flat_set<std::string> total_validities;
-        unsigned int dimension = datasets.begin()->dimension_;
-        for (DatasetList::iterator dataset_it = datasets.begin(); dataset_it != datasets.end(); ++dataset_it)
+        try
         {
-          if (dataset_it->name_ == dataset_name)
-          {
-            if (dataset_it->dimension_ != dimension)
-            {
-              throw make_exception<parsing_error>("different dimension given at different places");
-            }
-            subset.push_back(dataset_it);
-            for (std::vector<std::string>::const_iterator region_it = dataset_it->validity_.begin(); region_it != dataset_it->validity_.end(); ++region_it)
-            {
-              if (region_vertex_indices_.find(*region_it) == region_vertex_indices_.end())
-              {
-                throw make_exception<parsing_error>("invalid validity region: " + *region_it);
-              }
-              if (total_validities.find(*region_it) != total_validities.end())
-              {
-                throw make_exception<parsing_error>("region: " + *region_it + " is specified in more than one validity array in a single file for a single dataset");
-              }
-              total_validities.insert(*region_it);
-            }
-          }
+          snapshot_writer swriter(snapshot_path, filepath, snapshot_kind_dataset);
+          save_snapshot(swriter, datasets);
+          swriter.commit();
         }
-        
-        std::string unique_name = generate_unique_name(dataset_name, filepath);
-        if (total_validities.size() == region_vertex_indices_.size())
+        catch (parsing_error const &)
         {
-          //complete dataset
-          complete_datasets_[unique_name].first = dimension;
-          ValueVector & values = complete_datasets_[unique_name].second;
-          if (subset.size() == 1)
-          {
-            //optimization for datasets that define all their values in one fell swoop
-            values = datasets.begin()->values_;
-          }
-          else
+        }
+      }
+    }
+    
+    unify_datasets(datasets, filepath);
+    update_peak_bytes(0);
+  }
+  catch(parsing_error const & e)
+  {
+    throw make_exception<parsing_error>("while parsing file: " + filepath + " - " + e.what());
+  }
+}
+
+void data_reader::read_many(std::vector<std::string> const & filepaths)
+{
+  if (!sinks_.empty())
+  {
+    for (std::vector<std::string>::const_iterator it = filepaths.begin(); it != filepaths.end(); ++it)
+    {
+      read(*it);
+    }
+    return;
+  }
+  
+  //parsing only reads the (immutable) region information, thus the files can be parsed concurrently
+  //  exceptions must not leave the parallel region, the first error (in file order) is thrown afterwards
+  enum error_kind { no_error, parsing_failed, out_of_memory, other_error };
+  std::vector<std::string> errors(filepaths.size());
+  std::vector<char> error_kinds(filepaths.size(), no_error);
+  bool failed = false;
+  long const count = static_cast<long>(filepaths.size());
+  #pragma omp parallel for ordered schedule(dynamic)
+  for (long i = 0; i < count; ++i)
+  {
+    DatasetList datasets;
+    std::size_t parse_bytes = 0;
+    try
+    {
+      parse_bytes = parse(input_source::file(filepaths[i]), datasets);
+    }
+    catch (parsing_error const & e)
+    {
+      errors[i] = e.what();
+      error_kinds[i] = parsing_failed;
+    }
+    catch (std::bad_alloc const &)
+    {
+      error_kinds[i] = out_of_memory;
+    }
+    catch (std::exception const & e)
+    {
+      errors[i] = e.what();
+      error_kinds[i] = other_error;
+    }
+    catch (...)
+    {
+      error_kinds[i] = other_error;
+    }
+    
+    #pragma omp ordered
+    {
+      //the files after a failed one are not merged
+      if (!failed && error_kinds[i] == no_error)
+      {
+        try
+        {
+          update_peak_bytes(parse_bytes);
+          unify_datasets(datasets, filepaths[i]);
+          update_peak_bytes(0);
+        }
+        catch (parsing_error const & e)
+        {
+          errors[i] = e.what();
+          error_kinds[i] = parsing_failed;
+        }
+        catch (std::bad_alloc const &)
+        {
+          error_kinds[i] = out_of_memory;
+        }
+        catch (std::exception const & e)
+        {
+          errors[i] = e.what();
+          error_kinds[i] = other_error;
+        }
+        catch (...)
+        {
+          error_kinds[i] = other_error;
+        }
+      }
+      failed = failed || error_kinds[i] != no_error;
+    }
+  }
+  
+  for (std::vector<std::string>::size_type i = 0; i < filepaths.size(); ++i)
+  {
+    switch (error_kinds[i])
+    {
+      case no_error:
+      {
+        continue;
+      }
+      case parsing_failed:
+      {
+        throw make_exception<parsing_error>("while parsing file: " + filepaths[i] + " - " + errors[i]);
+      }
+      case out_of_memory:
+      {
+        throw std::bad_alloc();
+      }
+      case other_error:
+      {
+        //exceptions cannot be carried out of the parallel region in C++03, only their message is kept
+        throw std::runtime_error(errors[i].empty() ? "reading file " + filepaths[i] + " failed" : errors[i]);
+      }
+    }
+  }
+}
+
+std::size_t data_reader::parse(input_source const & source, DatasetList & datasets)
+{
+  primary_reader preader( source
+                        , boost::bind(&data_reader::parse_additional_info, this, _1, boost::ref(datasets))
+                        , boost::bind(&data_reader::parse_data_block, this, _1, boost::ref(datasets))
+                        , read_mode_
+                        );
+  return dataset_bytes(datasets) + preader.get_buffered_bytes();
+}
+
+std::size_t data_reader::dataset_bytes(DatasetList const & datasets)
+{
+  std::size_t bytes = 0;
+  for (DatasetList::const_iterator it = datasets.begin(); it != datasets.end(); ++it)
+  {
+    bytes += sizeof(Dataset) + 2*sizeof(void *) + heap_bytes(it->name_) + heap_bytes(it->function_) + heap_bytes(it->validity_) + heap_bytes(it->values_);
+  }
+  return bytes;
+}
+
+void data_reader::update_peak_bytes(std::size_t pending_bytes)
+{
+  std::size_t bytes = get_memory_usage().total_bytes() + pending_bytes;
+  if (bytes > peak_bytes_)
+  {
+    peak_bytes_ = bytes;
+  }
+}
+
+memory_usage data_reader::get_memory_usage() const
+{
+  memory_usage usage;
+  
+  std::size_t region_bytes = region_vertex_indices_.capacity() * sizeof(RegionVertexIndicesMap::value_type);
+  for (RegionVertexIndicesMap::const_iterator it = region_vertex_indices_.begin(); it != region_vertex_indices_.end(); ++it)
+  {
+    region_bytes += heap_bytes(it->first) + it->second.capacity() * sizeof(grd_bnd_reader::VertexIndex);
+  }
+  usage.add("region vertex indices", region_bytes);
+  usage.add("vertex map", heap_bytes(vertex_map_));
+  
+  //the vertex indices of partial datasets are shared with the validity unions and among each other, they are counted once
+  std::set<VertexIndexVector const *> shared;
+  std::size_t shared_bytes = 0;
+  std::size_t union_bytes = 0;
+  for (std::map<std::vector<std::string>, SharedVertexIndexVector>::const_iterator it = validity_unions_.begin(); it != validity_unions_.end(); ++it)
+  {
+    union_bytes += map_node_bytes(validity_unions_) + heap_bytes(it->first);
+    if (shared.insert(it->second.get()).second)
+    {
+      shared_bytes += heap_bytes(*it->second);
+    }
+  }
+  usage.add("validity unions", union_bytes);
+  
+  std::size_t partial_bytes = 0;
+  for (PartialDatasetMap::const_iterator it = partial_datasets_.begin(); it != partial_datasets_.end(); ++it)
+  {
+    partial_bytes += map_node_bytes(partial_datasets_) + heap_bytes(it->first) + heap_bytes(it->second.second.second);
+    if (it->second.second.first && shared.insert(it->second.second.first.get()).second)
+    {
+      shared_bytes += heap_bytes(*it->second.second.first);
+    }
+  }
+  usage.add("partial datasets", partial_bytes);
+  usage.add("partial dataset vertex indices", shared_bytes);
+  
+  std::size_t complete_bytes = 0;
+  for (CompleteDatasetMap::const_iterator it = complete_datasets_.begin(); it != complete_datasets_.end(); ++it)
+  {
+    complete_bytes += map_node_bytes(complete_datasets_) + heap_bytes(it->first) + heap_bytes(it->second.second);
+  }
+  usage.add("complete datasets", complete_bytes);
+  
+  usage.peak_bytes_ = peak_bytes_;
+  return usage;
+}
+
+bool data_reader::load_snapshot(snapshot_reader & sreader, DatasetList & datasets) const
+{
+  boost::uint64_t dimension;
+  boost::uint64_t vertex_count;
+  boost::uint64_t element_count;
+  boost::uint64_t region_count;
+  boost::uint64_t dataset_count;
+  if (  !sreader.read(dimension) || !sreader.read(vertex_count) || !sreader.read(element_count) || !sreader.read(region_count)
+     || !sreader.read(dataset_count)
+     )
+  {
+    return false;
+  }
+  //the snapshot is fine, but it might not belong to this grid
+  check_basic_info( static_cast<unsigned int>(dimension), static_cast<unsigned int>(vertex_count)
+                  , static_cast<unsigned int>(element_count), static_cast<std::size_t>(region_count)
+                  );
+  
+  for (boost::uint64_t i = 0; i < dataset_count; ++i)
+  {
+    Dataset & dataset = *datasets.insert(datasets.end(), Dataset());
+    boost::uint64_t dataset_dimension;
+    if (  !sreader.read(dataset.name_) || !sreader.read(dataset.function_) || !sreader.read(dataset.validity_)
+       || !sreader.read(dataset_dimension) || !sreader.read(dataset.values_)
+       )
+    {
+      return false;
+    }
+    dataset.dimension_ = static_cast<unsigned int>(dataset_dimension);
+  }
+  return true;
+}
+
+void data_reader::save_snapshot(snapshot_writer & swriter, DatasetList const & datasets) const
+{
+  swriter.write(static_cast<boost::uint64_t>(dimension_));
+  swriter.write(static_cast<boost::uint64_t>(file_vertex_count_));
+  swriter.write(static_cast<boost::uint64_t>(element_count_));
+  swriter.write(static_cast<boost::uint64_t>(file_region_count_));
+  swriter.write(static_cast<boost::uint64_t>(datasets.size()));
+  for (DatasetList::const_iterator it = datasets.begin(); it != datasets.end(); ++it)
+  {
+    swriter.write(it->name_);
+    swriter.write(it->function_);
+    swriter.write(it->validity_);
+    swriter.write(static_cast<boost::uint64_t>(it->dimension_));
+    swriter.write(it->values_);
+  }
+}
+
+void data_reader::check_basic_info(unsigned int dimension, unsigned int vertex_count, unsigned int element_count, std::size_t region_count) const
+{
+  if (  dimension != dimension_
+     || vertex_count != file_vertex_count_
+     || element_count != element_count_
+     || region_count != file_region_count_
+     )
+  {
+    throw make_exception<parsing_error>("basic information (dimension, number of vertices/elements/regions) mismatch");
+  }
+}
+
+data_reader::validity_scope data_reader::classify_validity(std::vector<std::string> const & validity) const
+{
+  std::size_t skipped = 0;
+  for (std::vector<std::string>::const_iterator it = validity.begin(); it != validity.end(); ++it)
+  {
+    skipped += skipped_regions_.count(*it);
+  }
+  if (skipped == 0)
+  {
+    return validity_selected;
+  }
+  if (skipped == validity.size())
+  {
+    return validity_skipped;
+  }
+  if (validity.size() == file_region_count_)
+  {
+    return validity_whole_file;
+  }
+  throw make_exception<parsing_error>("dataset is valid on both selected and skipped regions, it cannot be reduced to the selected regions");
+}
+
+void data_reader::subset_datasets(DatasetList & datasets) const
+{
+  if (skipped_regions_.empty())
+  {
+    return;
+  }
+  for (DatasetList::iterator it = datasets.begin(); it != datasets.end();)
+  {
+    try
+    {
+      validity_scope scope = classify_validity(it->validity_);
+      if (scope == validity_skipped)
+      {
+        it = datasets.erase(it);
+        continue;
+      }
+      if (scope == validity_whole_file)
+      {
+        subset_values(*it);
+      }
+    }
+    catch(parsing_error const & e)
+    {
+      throw make_exception<parsing_error>("while parsing dataset: " + it->name_ + " - " + e.what());
+    }
+    ++it;
+  }
+}
+
+//the values of the whole file are ordered by vertex index and vertices keep their relative order, thus the values can be
+//moved forward in place
+void data_reader::subset_values(Dataset & dataset) const
+{
+  check_value_count(static_cast<std::size_t>(file_vertex_count_)*dataset.dimension_, dataset.values_.size());
+  for (std::size_t vertex = 0; vertex < vertex_map_.size(); ++vertex)
+  {
+    if (vertex_map_[vertex] != grd_bnd_reader::invalid_index)
+    {
+      std::copy( dataset.values_.begin() + vertex*dataset.dimension_, dataset.values_.begin() + (vertex+1)*dataset.dimension_
+               , dataset.values_.begin() + static_cast<std::size_t>(vertex_map_[vertex])*dataset.dimension_
+               );
+    }
+  }
+  ValueVector(dataset.values_.begin(), dataset.values_.begin() + static_cast<std::size_t>(vertex_count_)*dataset.dimension_).swap(dataset.values_);
+  
+  std::vector<std::string> validity;
+  for (std::vector<std::string>::const_iterator it = dataset.validity_.begin(); it != dataset.validity_.end(); ++it)
+  {
+    if (skipped_regions_.count(*it) == 0)
+    {
+      validity.push_back(*it);
+    }
+  }
+  dataset.validity_.swap(validity);
+}
+
+void data_reader::unify_datasets(DatasetList & datasets, std::string const & filepath)
+{
+  subset_datasets(datasets);
+  
+  //group the datasets by name (in the order of their first appearance) within a single pass
+  std::vector<std::vector<DatasetList::iterator> > subsets;
+  std::map<std::string, std::size_t> subset_indices;
+  for (DatasetList::iterator dataset_it = datasets.begin(); dataset_it != datasets.end(); ++dataset_it)
+  {
+    std::pair<std::map<std::string, std::size_t>::iterator, bool> inserted = subset_indices.insert(std::make_pair(dataset_it->name_, subsets.size()));
+    if (inserted.second)
+    {
+      subsets.push_back(std::vector<DatasetList::iterator>());
+    }
+    subsets[inserted.first->second].push_back(dataset_it);
+  }
+  
+  for (std::vector<std::vector<DatasetList::iterator> >::const_iterator subset_it = subsets.begin(); subset_it != subsets.end(); ++subset_it)
+  {
+    unify_dataset(*subset_it, filepath);
+  }
+  datasets.clear();
+}
+
+//the values of the datasets are swapped into their final place or scattered there in a single linear pass, the vertices of
+//every Dataset block are a sorted subsequence of the vertices of the whole dataset (which are sorted as well)
+void data_reader::unify_dataset(std::vector<DatasetList::iterator> const & subset, std::string const & filepath)
+{
+  std::string const & dataset_name = subset.front()->name_;
+  try
+  {
+    boost::container::flat_set<std::string> total_validities;
+    unsigned int dimension = subset.front()->dimension_;
+    for (std::vector<DatasetList::iterator>::const_iterator it = subset.begin(); it != subset.end(); ++it)
+    {
+      if ((*it)->dimension_ != dimension)
+      {
+        throw make_exception<parsing_error>("different dimension given at different places");
+      }
+      for (std::vector<std::string>::const_iterator region_it = (*it)->validity_.begin(); region_it != (*it)->validity_.end(); ++region_it)
+      {
+        if (region_vertex_indices_.find(*region_it) == region_vertex_indices_.end())
+        {
+          throw make_exception<parsing_error>("invalid validity region: " + *region_it);
+        }
+        if (!total_validities.insert(*region_it).second)
+        {
+          throw make_exception<parsing_error>("region: " + *region_it + " is specified in more than one validity array in a single file for a single dataset");
+        }
+      }
+    }
+    
+    std::string unique_name = generate_unique_name(dataset_name, filepath);
+    if (total_validities.size() == region_vertex_indices_.size())
+    {
+      //complete dataset
+      complete_datasets_[unique_name].first = dimension;
+      ValueVector & values = complete_datasets_[unique_name].second;
+      if (subset.size() == 1)
+      {
+        //optimization for datasets that define all their values in one fell swoop
+        values.swap(subset.front()->values_);
+      }
+      else
+      {
+        values.resize(vertex_count_*dimension);
+        for (std::vector<DatasetList::iterator>::const_iterator it = subset.begin(); it != subset.end(); ++it)
+        {
+          VertexIndexRange vertices = combine_region_indices((*it)->validity_);
+          std::size_t vertex_count = vertices.second - vertices.first;
+          check_value_count(vertex_count*dimension, (*it)->values_.size());
+          
+          double const * source = (vertex_count == 0) ? 0 : &(*it)->values_[0];
+          for (std::size_t i = 0; i < vertex_count; ++i, source += dimension)
           {
-            values.resize(vertex_count_*dimension);
-            for (std::vector<DatasetList::iterator>::iterator it = subset.begin(); it != subset.end(); ++it)
-            {
-              VertexIndexSet combined_indices;
-              combine_region_indices((*it)->validity_, combined_indices);
-              
-              if (combined_indices.size()*dimension != (*it)->values_.size())
-              {
-                throw make_exception<parsing_error>( "invalid number of values, expected: "
-                                                   + boost::lexical_cast<std::string>(combined_indices.size()*dimension)
-                                                   + ", got: " + boost::lexical_cast<std::string>((*it)->values_.size())
-                                                   );
-              }
-              
-              size_t i = 0;
-              for (VertexIndexSet::const_iterator combined_it = combined_indices.begin(); combined_it != combined_indices.end(); ++i, ++combined_it)
-              {
-                for (size_t j = 0; j < dimension; ++j)
-                {
-                  values[(*combined_it)*dimension+j] = (*it)->values_[i*dimension+j];
-                }
-              }
-            }
+            std::copy(source, source + dimension, &values[static_cast<std::size_t>(vertices.first[i])*dimension]);
           }
         }
-        else
+      }
+    }
+    else
+    {
+      //partial dataset
+      partial_datasets_[unique_name].first = dimension;
+      SharedVertexIndexVector & vertex_indices = partial_datasets_[unique_name].second.first;
+      ValueVector & values = partial_datasets_[unique_name].second.second;
+      
+      std::vector<VertexIndexRange> subset_vertices(subset.size());
+      for (std::size_t k = 0; k < subset.size(); ++k)
+      {
+        subset_vertices[k] = combine_region_indices(subset[k]->validity_);
+        check_value_count((subset_vertices[k].second - subset_vertices[k].first)*dimension, subset[k]->values_.size());
+      }
+      
+      vertex_indices = validity_union(std::vector<std::string>(total_validities.begin(), total_validities.end()));
+      if (subset.size() == 1)
+      {
+        values.swap(subset.front()->values_);
+      }
+      else
+      {
+        values.resize(vertex_indices->size()*dimension);
+        for (std::size_t k = 0; k < subset.size(); ++k)
         {
-          //partial dataset
-          partial_datasets_[unique_name].first = dimension;
-          VertexIndexSet total_combined_indices;
-          combine_region_indices(std::vector<std::string>(total_validities.begin(), total_validities.end()), total_combined_indices);
-          
-          VertexIndexVector & vertex_indices = partial_datasets_[unique_name].second.first;
-          vertex_indices.reserve(total_combined_indices.size());
-          vertex_indices.insert(vertex_indices.begin(), total_combined_indices.begin(), total_combined_indices.end());
-          ValueVector & values = partial_datasets_[unique_name].second.second;
-          
-          values.resize(total_combined_indices.size()*dimension);
-          for (std::vector<DatasetList::iterator>::iterator it = subset.begin(); it != subset.end(); ++it)
+          //walking along both sorted sequences yields the slot of every vertex without searching for it
+          VertexIndexVector::const_iterator slot = vertex_indices->begin();
+          double const * source = subset_vertices[k].first == subset_vertices[k].second ? 0 : &subset[k]->values_[0];
+          for (grd_bnd_reader::VertexIndex const * vertex = subset_vertices[k].first; vertex != subset_vertices[k].second; ++vertex, source += dimension)
           {
-            VertexIndexSet combined_indices;
-            combine_region_indices((*it)->validity_, combined_indices);
-            
-            if (combined_indices.size()*dimension != (*it)->values_.size())
-            {
-              throw make_exception<parsing_error>( "invalid number of values, expected: "
-                                                  + boost::lexical_cast<std::string>(combined_indices.size()*dimension)
-                                                  + ", got: " + boost::lexical_cast<std::string>((*it)->values_.size())
-                                                  );
-            }
-            
-            size_t i = 0;
-            for (VertexIndexSet::const_iterator combined_it = combined_indices.begin(); combined_it != combined_indices.end(); ++i, ++combined_it)
+            while (*slot != *vertex)
             {
-              size_t offset = (total_combined_indices.find(*combined_it)-total_combined_indices.begin())*dimension;
-              for (size_t j = 0; j < dimension; ++j)
-              {
-                values[offset+j] = (*it)->values_[i*dimension+j];
-              }
+              ++slot;
             }
+            std::copy(source, source + dimension, &values[(slot - vertex_indices->begin())*dimension]);
           }
         }
-        
-        //remove all datasets that we just unified
-        for (std::vector<DatasetList::iterator>::iterator it = subset.begin(); it != subset.end(); ++it)
-        {
-          datasets.erase(*it);
-        }
-      }
-      catch (parsing_error const & e)
-      {
-        throw make_exception<parsing_error>("while unifying dataset: " + dataset_name + " - " + e.what());
       }
     }
   }
-  catch(parsing_error const & e)
+  catch (parsing_error const & e)
   {
-    throw make_exception<parsing_error>("while parsing file: " + filepath + " - " + e.what());
+    throw make_exception<parsing_error>("while unifying dataset: " + dataset_name + " - " + e.what());
   }
 }
 
@@ -212,14 +703,9 @@ void data_reader::parse_additional_info(primary_reader & preader, DatasetList &
                                        );
   }
   
-  if (  preader.get_mandatory_info().dimension_ != dimension_
-     || preader.get_mandatory_info().nb_vertices_ != vertex_count_
-     || preader.get_mandatory_info().nb_elements_ != element_count_
-     || preader.get_mandatory_info().nb_regions_ != region_vertex_indices_.size()
-     )
-  {
-    throw make_exception<parsing_error>("basic information (dimension, number of vertices/elements/regions) mismatch");
-  }
+  check_basic_info( preader.get_mandatory_info().dimension_, preader.get_mandatory_info().nb_vertices_
+                  , preader.get_mandatory_info().nb_elements_, preader.get_mandatory_info().nb_regions_
+                  );
   
   std::vector<std::string> names;
   std::vector<std::string> functions;
@@ -241,25 +727,206 @@ void data_reader::parse_additional_info(primary_reader & preader, DatasetList &
 
 void data_reader::parse_data_block(primary_reader & preader, DatasetList & datasets)
 {
+  //sinks need not be thread-safe, the blocks are only parsed concurrently without them (see primary_reader::read_blocks)
+  if (sinks_.empty())
+  {
+    std::vector<Dataset *> blocks;
+    blocks.reserve(datasets.size());
+    for (DatasetList::iterator it = datasets.begin(); it != datasets.end(); ++it)
+    {
+      blocks.push_back(&*it);
+    }
+    preader.read_blocks("Dataset", blocks.size(), boost::bind(&data_reader::read_dataset_block, this, _1, boost::cref(blocks), _2));
+    return;
+  }
+  
+  StreamedValidityMap streamed;
   for (DatasetList::iterator it = datasets.begin(); it != datasets.end(); ++it)
   {
-    preader.read_block<std::string>("Dataset", boost::bind(parse_dataset_block, boost::ref(preader), boost::ref(*it), _1));
+    if (sinks_.find(it->name_) != sinks_.end())
+    {
+      preader.read_block<std::string>("Dataset", boost::bind(&data_reader::stream_dataset_block, this, boost::ref(preader), boost::ref(*it), boost::ref(streamed), _1));
+    }
+    else
+    {
+      preader.read_block<std::string>("Dataset", boost::bind(&data_reader::parse_dataset_block, this, boost::ref(preader), boost::ref(*it), _1));
+    }
+  }
+}
+
+void data_reader::stream_dataset_block(primary_reader & preader, Dataset & dataset, StreamedValidityMap & streamed, std::string const & para)
+{
+  if (para != dataset.name_)
+  {
+    throw make_exception<parsing_error>("unexpected dataset name: " + para + " - expected name: " + dataset.name_);
+  }
+  
+  try
+  {
+    parse_dataset_header(preader, dataset);
+    validity_scope scope = classify_validity(dataset.validity_);
+    if (scope == validity_skipped)
+    {
+      preader.skip_block("Values");
+      return;
+    }
+    if (scope == validity_whole_file)
+    {
+      //the values of skipped vertices are interleaved with the others, the block is read as a whole and then reduced
+      preader.read_block<std::vector<double>::size_type>("Values", boost::bind(parse_dataset_values_block, boost::ref(preader), boost::ref(dataset.values_), _1));
+      subset_values(dataset);
+      check_streamed_validity(dataset, streamed);
+      stream_values(dataset);
+      ValueVector().swap(dataset.values_);
+      return;
+    }
+    check_streamed_validity(dataset, streamed);
+    
+    VertexIndexRange vertices = combine_region_indices(dataset.validity_);
+    dataset_sink & sink = *sinks_[dataset.name_];
+    sink.begin_block(dataset.name_, dataset.dimension_, dataset.validity_, vertices.second - vertices.first);
+    preader.read_block<std::vector<double>::size_type>("Values", boost::bind(&data_reader::stream_dataset_values_block, this, boost::ref(preader), boost::cref(dataset), vertices, _1));
+    sink.end_block();
+  }
+  catch(parsing_error const & e)
+  {
+    throw make_exception<parsing_error>("while parsing dataset: " + dataset.name_ + " - " + e.what());
+  }
+}
+
+void data_reader::stream_dataset_values_block( primary_reader & preader, Dataset const & dataset, VertexIndexRange const & vertices
+                                             , std::vector<double>::size_type const & para
+                                             )
+{
+  std::size_t const vertex_count = vertices.second - vertices.first;
+  check_value_count(vertex_count*dataset.dimension_, para);
+  
+  //the values are passed on in batches of vertices, only a single batch is buffered at a time
+  std::size_t const batch_size = 4096;
+  std::vector<double> values(std::min(batch_size, vertex_count)*dataset.dimension_);
+  dataset_sink & sink = *sinks_[dataset.name_];
+  for (std::size_t begin = 0; begin < vertex_count; begin += batch_size)
+  {
+    std::size_t count = std::min(batch_size, vertex_count - begin);
+    preader.read_values(&values[0], count*dataset.dimension_);
+    sink.consume(vertices.first + begin, &values[0], count);
   }
 }
 
-void data_reader::combine_region_indices(std::vector<std::string> const & validity, VertexIndexSet & combined_indices)
+void data_reader::stream_restored_datasets(DatasetList & datasets)
+{
+  subset_datasets(datasets);
+  StreamedValidityMap streamed;
+  for (DatasetList::iterator it = datasets.begin(); it != datasets.end();)
+  {
+    std::map<std::string, dataset_sink *>::const_iterator sink_it = sinks_.find(it->name_);
+    if (sink_it == sinks_.end())
+    {
+      ++it;
+      continue;
+    }
+    
+    try
+    {
+      check_streamed_validity(*it, streamed);
+      stream_values(*it);
+    }
+    catch(parsing_error const & e)
+    {
+      throw make_exception<parsing_error>("while parsing dataset: " + it->name_ + " - " + e.what());
+    }
+    it = datasets.erase(it);
+  }
+}
+
+void data_reader::stream_values(Dataset const & dataset)
+{
+  VertexIndexRange vertices = combine_region_indices(dataset.validity_);
+  std::size_t vertex_count = vertices.second - vertices.first;
+  check_value_count(vertex_count*dataset.dimension_, dataset.values_.size());
+  dataset_sink & sink = *sinks_[dataset.name_];
+  sink.begin_block(dataset.name_, dataset.dimension_, dataset.validity_, vertex_count);
+  if (vertex_count != 0)
+  {
+    sink.consume(vertices.first, &dataset.values_[0], vertex_count);
+  }
+  sink.end_block();
+}
+
+//the checks unify_datasets does for datasets that are not streamed
+void data_reader::check_streamed_validity(Dataset const & dataset, StreamedValidityMap & streamed) const
+{
+  std::pair<StreamedValidityMap::iterator, bool> inserted = streamed.insert(std::make_pair( dataset.name_
+                                                                                          , std::make_pair(dataset.dimension_, boost::container::flat_set<std::string>())
+                                                                                          ));
+  if (!inserted.second && inserted.first->second.first != dataset.dimension_)
+  {
+    throw make_exception<parsing_error>("different dimension given at different places");
+  }
+  for (std::vector<std::string>::const_iterator region_it = dataset.validity_.begin(); region_it != dataset.validity_.end(); ++region_it)
+  {
+    if (region_vertex_indices_.find(*region_it) == region_vertex_indices_.end())
+    {
+      throw make_exception<parsing_error>("invalid validity region: " + *region_it);
+    }
+    if (!inserted.first->second.second.insert(*region_it).second)
+    {
+      throw make_exception<parsing_error>("region: " + *region_it + " is specified in more than one validity array in a single file for a single dataset");
+    }
+  }
+}
+
+bool data_reader::remove_streamed_datasets(DatasetList & datasets) const
+{
+  bool removed = false;
+  for (DatasetList::iterator it = datasets.begin(); it != datasets.end();)
+  {
+    if (sinks_.find(it->name_) != sinks_.end())
+    {
+      it = datasets.erase(it);
+      removed = true;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  return removed;
+}
+
+//single regions are used as they are, unions of regions are taken from the cache
+data_reader::VertexIndexRange data_reader::combine_region_indices(std::vector<std::string> const & validity)
 {
   if (validity.size() == 1)
   {
-    combined_indices = region_vertex_indices_[validity[0]];
+    VertexIndexSet const & vertices = region_vertex_indices_[validity[0]];
+    return vertices.empty() ? VertexIndexRange(0, 0) : VertexIndexRange(&*vertices.begin(), &*vertices.begin() + vertices.size());
   }
-  else
+  
+  VertexIndexVector const & vertices = *validity_union(validity);
+  return vertices.empty() ? VertexIndexRange(0, 0) : VertexIndexRange(&vertices[0], &vertices[0] + vertices.size());
+}
+
+data_reader::SharedVertexIndexVector data_reader::validity_union(std::vector<std::string> validity)
+{
+  std::sort(validity.begin(), validity.end());
+  std::map<std::vector<std::string>, SharedVertexIndexVector>::const_iterator cached = validity_unions_.find(validity);
+  if (cached != validity_unions_.end())
+  {
+    return cached->second;
+  }
+  
+  boost::shared_ptr<VertexIndexVector> vertices(new VertexIndexVector());
+  for (std::vector<std::string>::const_iterator it = validity.begin(); it != validity.end(); ++it)
   {
-    for (std::vector<std::string>::const_iterator it = validity.begin(); it != validity.end(); ++it)
+    VertexIndexSet const & region_vertices = region_vertex_indices_[*it];
+    if (!region_vertices.empty())
     {
-      combined_indices.insert(region_vertex_indices_[*it].begin(), region_vertex_indices_[*it].end());
+      merge_into(*vertices, &*region_vertices.begin(), &*region_vertices.begin() + region_vertices.size());
     }
   }
+  validity_unions_.insert(std::make_pair(validity, vertices));
+  return vertices;
 }
 
 bool data_reader::is_unique(std::string const & dataset_name) const
@@ -276,7 +943,8 @@ std::string data_reader::generate_unique_name(std::string const & dataset_name,
     return dataset_name;
   }
   
-  std::string file_stem = viennautils::filesystem::extract_stem(filepath);
+  //compressed files get the same names as their uncompressed counterparts
+  std::string file_stem = viennautils::filesystem::extract_stem(strip_compression_extension(filepath));
   
   std::string dataset_stem_name = dataset_name + "_" + file_stem;
   if (is_unique(dataset_stem_name))
@@ -294,7 +962,12 @@ std::string data_reader::generate_unique_name(std::string const & dataset_name,
   }
 }
 
-void data_reader::parse_dataset_block(primary_reader & preader, Dataset & dataset, std::string const & para)
+void data_reader::read_dataset_block(primary_reader & preader, std::vector<Dataset *> const & datasets, std::size_t index) const
+{
+  preader.read_block<std::string>("Dataset", boost::bind(&data_reader::parse_dataset_block, this, boost::ref(preader), boost::ref(*datasets[index]), _1));
+}
+
+void data_reader::parse_dataset_block(primary_reader & preader, Dataset & dataset, std::string const & para) const
 {
   if (para != dataset.name_)
   {
@@ -303,39 +976,207 @@ void data_reader::parse_dataset_block(primary_reader & preader, Dataset & datase
   
   try
   {
-    expect(preader, "function", dataset.function_);
-    std::string type;
-    preader.read_attribute("type", type);
-    if (type == "scalar")
+    parse_dataset_header(preader, dataset);
+    if (classify_validity(dataset.validity_) == validity_skipped)
+    {
+      //dropped by subset_datasets
+      preader.skip_block("Values");
+      return;
+    }
+    preader.read_block<std::vector<double>::size_type>("Values", boost::bind(parse_dataset_values_block, boost::ref(preader), boost::ref(dataset.values_), _1));
+  }
+  catch(parsing_error const & e)
+  {
+    throw make_exception<parsing_error>("while parsing dataset: " + dataset.name_ + " - " + e.what());
+  }
+}
+
+void data_reader::parse_dataset_header(primary_reader & preader, Dataset & dataset)
+{
+  expect(preader, "function", dataset.function_);
+  std::string type;
+  preader.read_attribute("type", type);
+  if (type == "scalar")
+  {
+    expect(preader, "dimension", "1");
+    dataset.dimension_ = 1;
+  }
+  else if (type == "vector")
+  {
+    preader.read_attribute("dimension", dataset.dimension_);
+  }
+  else
+  {
+    throw make_exception<parsing_error>("unexpected value for attribute: type - got value: " + type);
+  }
+  expect(preader, "location", "vertex");
+  
+  preader.read_array("validity", dataset.validity_);
+}
+
+void data_reader::parse_dataset_values_block(primary_reader & preader, std::vector<double> & values, std::vector<double>::size_type const & para)
+{
+  values.resize(para);
+  if (!values.empty())
+  {
+    preader.read_values(&values[0], values.size());
+  }
+}
+
+dataset_file::dataset_file( data_reader & reader
+                          , std::string const & filepath
+                          )
+                          : reader_(reader)
+                          , filepath_(filepath)
+{
+  open(std::string());
+}
+
+dataset_file::dataset_file( data_reader & reader
+                          , std::string const & filepath
+                          , std::string const & index_path
+                          )
+                          : reader_(reader)
+                          , filepath_(filepath)
+{
+  open(index_path);
+}
+
+dataset_file::~dataset_file()
+{
+}
+
+void dataset_file::open(std::string const & index_path)
+{
+  try
+  {
+    preader_.reset(new primary_reader(input_source::file(filepath_, index_path), boost::bind(&dataset_file::parse_additional_info, this, _1)));
+    preader_->read_block("Data", boost::bind(&dataset_file::parse_data_block, this));
+  }
+  catch(parsing_error const & e)
+  {
+    throw make_exception<parsing_error>("while parsing file: " + filepath_ + " - " + e.what());
+  }
+  
+  //summarize the blocks per dataset name (in order of their first appearance)
+  for (DatasetBlockVector::const_iterator block_it = dataset_blocks_.begin(); block_it != dataset_blocks_.end(); ++block_it)
+  {
+    DatasetInfoVector::iterator info_it = dataset_infos_.begin();
+    for (; info_it != dataset_infos_.end() && info_it->name_ != block_it->name_; ++info_it);
+    if (info_it == dataset_infos_.end())
+    {
+      dataset_info info;
+      info.name_ = block_it->name_;
+      info.function_ = block_it->function_;
+      info.dimension_ = block_it->dimension_;
+      info_it = dataset_infos_.insert(dataset_infos_.end(), info);
+    }
+    info_it->validity_.insert(info_it->validity_.end(), block_it->validity_.begin(), block_it->validity_.end());
+  }
+}
+
+std::string const & dataset_file::load(std::string const & dataset_name)
+{
+  std::map<std::string, std::string>::const_iterator loaded_it = loaded_datasets_.find(dataset_name);
+  if (loaded_it != loaded_datasets_.end())
+  {
+    return loaded_it->second;
+  }
+  
+  try
+  {
+    data_reader::DatasetList datasets;
+    for (DatasetBlockVector::const_iterator block_it = dataset_blocks_.begin(); block_it != dataset_blocks_.end(); ++block_it)
     {
-      expect(preader, "dimension", "1");
-      dataset.dimension_ = 1;
+      if (block_it->name_ != dataset_name)
+      {
+        continue;
+      }
+      
+      data_reader::Dataset & dataset = *datasets.insert(datasets.end(), data_reader::Dataset());
+      dataset.name_ = block_it->name_;
+      dataset.function_ = block_it->function_;
+      dataset.dimension_ = block_it->dimension_;
+      dataset.validity_ = block_it->validity_;
+      try
+      {
+        preader_->seek(block_it->values_offset_);
+        preader_->read_block<std::vector<double>::size_type>("Values", boost::bind(data_reader::parse_dataset_values_block, boost::ref(*preader_), boost::ref(dataset.values_), _1));
+      }
+      catch(parsing_error const & e)
+      {
+        throw make_exception<parsing_error>("while parsing dataset: " + dataset.name_ + " - " + e.what());
+      }
     }
-    else if (type == "vector")
+    if (datasets.empty())
     {
-      preader.read_attribute("dimension", dataset.dimension_);
+      throw make_exception<parsing_error>("no such dataset: " + dataset_name);
     }
-    else
+    reader_.subset_datasets(datasets);
+    if (datasets.empty())
     {
-      throw make_exception<parsing_error>("unexpected value for attribute: type - got value: " + type);
+      throw make_exception<parsing_error>("dataset is only valid on regions that were skipped: " + dataset_name);
     }
-    expect(preader, "location", "vertex");
     
-    preader.read_array("validity", dataset.validity_);
-    preader.read_block<std::vector<double>::size_type>("Values", boost::bind(parse_dataset_values_block, boost::ref(preader), boost::ref(dataset.values_), _1));
+    std::string unique_name = reader_.generate_unique_name(dataset_name, filepath_);
+    reader_.update_peak_bytes(data_reader::dataset_bytes(datasets) + preader_->get_buffered_bytes());
+    reader_.unify_datasets(datasets, filepath_);
+    reader_.update_peak_bytes(0);
+    return loaded_datasets_[dataset_name] = unique_name;
   }
   catch(parsing_error const & e)
   {
-    throw make_exception<parsing_error>("while parsing dataset: " + dataset.name_ + " - " + e.what());
+    throw make_exception<parsing_error>("while parsing file: " + filepath_ + " - " + e.what());
   }
 }
 
-void data_reader::parse_dataset_values_block(primary_reader & preader, std::vector<double> & values, std::vector<double>::size_type const & para)
+void dataset_file::parse_additional_info(primary_reader & preader)
 {
-  values.resize(para);
-  for (std::vector<double>::size_type i = 0; i < values.size(); ++i)
+  data_reader::DatasetList datasets;
+  reader_.parse_additional_info(preader, datasets);
+  for (data_reader::DatasetList::const_iterator it = datasets.begin(); it != datasets.end(); ++it)
+  {
+    dataset_block block;
+    block.name_ = it->name_;
+    block.function_ = it->function_;
+    dataset_blocks_.push_back(block);
+  }
+}
+
+void dataset_file::parse_data_block()
+{
+  for (DatasetBlockVector::iterator it = dataset_blocks_.begin(); it != dataset_blocks_.end(); ++it)
+  {
+    preader_->read_block<std::string>("Dataset", boost::bind(&dataset_file::parse_dataset_block, this, boost::ref(*it), _1));
+  }
+}
+
+void dataset_file::parse_dataset_block(dataset_block & block, std::string const & para)
+{
+  if (para != block.name_)
+  {
+    throw make_exception<parsing_error>("unexpected dataset name: " + para + " - expected name: " + block.name_);
+  }
+  
+  try
+  {
+    data_reader::Dataset header;
+    header.name_ = block.name_;
+    header.function_ = block.function_;
+    data_reader::parse_dataset_header(*preader_, header);
+    block.dimension_ = header.dimension_;
+    block.validity_.swap(header.validity_);
+    
+    block.values_offset_ = preader_->tell();
+    //the Values block is the last one within a Dataset block
+    if (!preader_->skip_to_block_end())
+    {
+      preader_->skip_block("Values");
+    }
+  }
+  catch(parsing_error const & e)
   {
-    preader.read_value(values[i]);
+    throw make_exception<parsing_error>("while parsing dataset: " + block.name_ + " - " + e.what());
   }
 }
 
@@ -0,0 +1,323 @@
+#include "viennautils/dfise/decompression.hpp"
+
+#include <string>
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+#include "viennautils/dfise/parsing_error.hpp"
+
+#ifdef VIENNAUTILS_DFISE_ZLIB
+  #include <zlib.h>
+#endif
+
+#ifdef VIENNAUTILS_DFISE_ZSTD
+  #include <zstd.h>
+#endif
+
+namespace viennautils
+{
+namespace dfise
+{
+
+namespace
+{
+
+unsigned char const gzip_magic[2] = {0x1f, 0x8b};
+unsigned char const zstd_magic[4] = {0x28, 0xb5, 0x2f, 0xfd};
+
+bool starts_with(char const* data, std::size_t size, unsigned char const* magic, std::size_t magic_size)
+{
+  return size >= magic_size && std::equal(magic, magic + magic_size, reinterpret_cast<unsigned char const*>(data));
+}
+
+#if defined(VIENNAUTILS_DFISE_ZLIB) || defined(VIENNAUTILS_DFISE_ZSTD)
+
+//the output grows in steps of at least this size if the uncompressed size is unknown (or was wrong)
+std::size_t const minimum_growth = 1 << 20;
+
+//the uncompressed size recorded in the data is only trusted as far as the compression ratio is plausible
+std::size_t initial_size(boost::uint64_t recorded_size, std::size_t compressed_size)
+{
+  boost::uint64_t const max_ratio = 1032; //the maximum ratio of deflate, zstd rarely gets there for real data
+  return static_cast<std::size_t>(std::max<boost::uint64_t>(std::min(recorded_size, compressed_size*max_ratio), minimum_growth));
+}
+
+void grow(std::vector<char> & target, std::size_t used)
+{
+  if (used == target.size())
+  {
+    target.resize(target.size() + std::max(target.size(), minimum_growth));
+  }
+}
+
+#endif
+
+#ifdef VIENNAUTILS_DFISE_ZLIB
+
+struct gzip_stream
+{
+  z_stream stream_;
+  std::size_t consumed_;
+};
+
+std::size_t read_gzip(gzip_stream & gzip, char const* data, std::size_t size, char* target, std::size_t target_size, bool & finished)
+{
+  z_stream & stream = gzip.stream_;
+  std::size_t produced = 0;
+  while (produced < target_size && !finished)
+  {
+    //zlib counts in unsigned int, so huge buffers are processed in several steps
+    uInt const max_step = 1u << 30;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + gzip.consumed_));
+    stream.avail_in = static_cast<uInt>(std::min<std::size_t>(size - gzip.consumed_, max_step));
+    stream.next_out = reinterpret_cast<Bytef*>(target + produced);
+    stream.avail_out = static_cast<uInt>(std::min<std::size_t>(target_size - produced, max_step));
+    uInt const avail_in = stream.avail_in;
+    uInt const avail_out = stream.avail_out;
+
+    int result = inflate(&stream, Z_NO_FLUSH);
+    gzip.consumed_ += avail_in - stream.avail_in;
+    produced += avail_out - stream.avail_out;
+
+    bool failed = (result != Z_OK && result != Z_BUF_ERROR && result != Z_STREAM_END);
+    if (result == Z_STREAM_END)
+    {
+      //concatenated members (e.g. gzip -c a b) form a single file
+      finished = (gzip.consumed_ == size);
+      failed = (!finished && inflateReset(&stream) != Z_OK);
+    }
+    else if (avail_in == stream.avail_in && avail_out == stream.avail_out && gzip.consumed_ == size)
+    {
+      //no progress without further input, i.e. the data is truncated
+      failed = true;
+    }
+    if (failed)
+    {
+      throw make_exception<parsing_error>("corrupt or truncated gzip data" + (stream.msg ? std::string(": ") + stream.msg : std::string()));
+    }
+  }
+  return produced;
+}
+
+#endif
+
+#ifdef VIENNAUTILS_DFISE_ZSTD
+
+struct zstd_stream
+{
+  ZSTD_DStream* stream_;
+  ZSTD_inBuffer input_;
+};
+
+std::size_t read_zstd(zstd_stream & zstd, char* target, std::size_t target_size, bool & finished)
+{
+  ZSTD_outBuffer output = {target, target_size, 0};
+  while (output.pos < target_size && !finished)
+  {
+    std::size_t const consumed = zstd.input_.pos;
+    std::size_t const produced = output.pos;
+    //returns 0 once a frame is complete and fully flushed, multiple frames are decompressed one after another
+    std::size_t result = ZSTD_decompressStream(zstd.stream_, &output, &zstd.input_);
+    if (ZSTD_isError(result))
+    {
+      throw make_exception<parsing_error>(std::string("corrupt zstd data: ") + ZSTD_getErrorName(result));
+    }
+    if (zstd.input_.pos == zstd.input_.size)
+    {
+      finished = (result == 0);
+      if (!finished && consumed == zstd.input_.pos && produced == output.pos)
+      {
+        throw make_exception<parsing_error>("truncated zstd data");
+      }
+    }
+  }
+  return output.pos;
+}
+
+#endif
+
+} //end of anonymous namespace
+
+compression detect_compression(char const* data, std::size_t size)
+{
+  if (starts_with(data, size, gzip_magic, sizeof(gzip_magic)))
+  {
+    return compression_gzip;
+  }
+  if (starts_with(data, size, zstd_magic, sizeof(zstd_magic)))
+  {
+    return compression_zstd;
+  }
+  return compression_none;
+}
+
+std::string strip_compression_extension(std::string const & path)
+{
+  char const* const extensions[] = {".gz", ".zst"};
+  for (std::size_t i = 0; i < sizeof(extensions)/sizeof(extensions[0]); ++i)
+  {
+    std::string extension(extensions[i]);
+    if (path.size() > extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0)
+    {
+      return path.substr(0, path.size() - extension.size());
+    }
+  }
+  return path;
+}
+
+struct decompressor::stream_state
+{
+  std::size_t consumed_; //compression_none only
+#ifdef VIENNAUTILS_DFISE_ZLIB
+  gzip_stream gzip_;
+#endif
+#ifdef VIENNAUTILS_DFISE_ZSTD
+  zstd_stream zstd_;
+#endif
+};
+
+decompressor::decompressor( compression method
+                          , char const* data
+                          , std::size_t size
+                          )
+                          : method_(method)
+                          , data_(data)
+                          , size_(size)
+                          , finished_(false)
+                          , state_(new stream_state())
+{
+  switch (method_)
+  {
+    case compression_none:
+    {
+      return;
+    }
+    case compression_gzip:
+    {
+#ifdef VIENNAUTILS_DFISE_ZLIB
+      //15 + 16: maximum window size, gzip header and trailer instead of zlib ones
+      if (inflateInit2(&state_->gzip_.stream_, 15 + 16) != Z_OK)
+      {
+        delete state_;
+        throw make_exception<parsing_error>("cannot initialize gzip decompression");
+      }
+      return;
+#else
+      delete state_;
+      throw make_exception<parsing_error>("gzip compressed files are not supported - rebuild with ENABLE_ZLIB");
+#endif
+    }
+    case compression_zstd:
+    {
+#ifdef VIENNAUTILS_DFISE_ZSTD
+      state_->zstd_.stream_ = ZSTD_createDStream();
+      if (state_->zstd_.stream_ == 0 || ZSTD_isError(ZSTD_initDStream(state_->zstd_.stream_)))
+      {
+        ZSTD_freeDStream(state_->zstd_.stream_);
+        delete state_;
+        throw make_exception<parsing_error>("cannot initialize zstd decompression");
+      }
+      ZSTD_inBuffer input = {data_, size_, 0};
+      state_->zstd_.input_ = input;
+      return;
+#else
+      delete state_;
+      throw make_exception<parsing_error>("zstd compressed files are not supported - rebuild with ENABLE_ZSTD");
+#endif
+    }
+  }
+}
+
+decompressor::~decompressor()
+{
+#ifdef VIENNAUTILS_DFISE_ZLIB
+  if (method_ == compression_gzip)
+  {
+    inflateEnd(&state_->gzip_.stream_);
+  }
+#endif
+#ifdef VIENNAUTILS_DFISE_ZSTD
+  if (method_ == compression_zstd)
+  {
+    ZSTD_freeDStream(state_->zstd_.stream_);
+  }
+#endif
+  delete state_;
+}
+
+std::size_t decompressor::read(char* target, std::size_t size)
+{
+  std::size_t produced = 0;
+  switch (method_)
+  {
+    case compression_none:
+    {
+      produced = std::min(size, size_ - state_->consumed_);
+      std::copy(data_ + state_->consumed_, data_ + state_->consumed_ + produced, target);
+      state_->consumed_ += produced;
+      finished_ = (state_->consumed_ == size_);
+      break;
+    }
+    case compression_gzip:
+    {
+#ifdef VIENNAUTILS_DFISE_ZLIB
+      produced = read_gzip(state_->gzip_, data_, size_, target, size, finished_);
+#endif
+      break;
+    }
+    case compression_zstd:
+    {
+#ifdef VIENNAUTILS_DFISE_ZSTD
+      produced = read_zstd(state_->zstd_, target, size, finished_);
+#endif
+      break;
+    }
+  }
+  return produced;
+}
+
+boost::uint64_t decompressor::get_recorded_size() const
+{
+#ifdef VIENNAUTILS_DFISE_ZLIB
+  //the last 4 bytes of a gzip member hold its uncompressed size (modulo 2^32, it is just a hint therefore)
+  if (method_ == compression_gzip && size_ >= 4)
+  {
+    unsigned char const* trailer = reinterpret_cast<unsigned char const*>(data_ + size_ - 4);
+    return trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (static_cast<boost::uint32_t>(trailer[3]) << 24);
+  }
+#endif
+#ifdef VIENNAUTILS_DFISE_ZSTD
+  if (method_ == compression_zstd)
+  {
+    unsigned long long size = ZSTD_getFrameContentSize(data_, size_);
+    return (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) ? 0 : size;
+  }
+#endif
+  return (method_ == compression_none) ? size_ : 0;
+}
+
+void decompress(compression method, char const* data, std::size_t size, std::vector<char> & target)
+{
+  if (method == compression_none)
+  {
+    target.assign(data, data + size);
+    return;
+  }
+  //the constructor throws if the support for method was not compiled in
+  decompressor source(method, data, size);
+#if defined(VIENNAUTILS_DFISE_ZLIB) || defined(VIENNAUTILS_DFISE_ZSTD)
+  target.resize(initial_size(source.get_recorded_size(), size));
+  std::size_t produced = 0;
+  while (!source.finished())
+  {
+    grow(target, produced);
+    produced += source.read(&target[produced], target.size() - produced);
+  }
+  target.resize(produced);
+#endif
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
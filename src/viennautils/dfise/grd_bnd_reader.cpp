@@ -1,28 +1,377 @@
 #include "viennautils/dfise/grd_bnd_reader.hpp"
 
+#include <algorithm>
+
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 #include <boost/ref.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/limits.hpp>
 
 #include "../../../include/viennautils/dfise/grd_bnd_reader.hpp"
 
 #include "viennautils/dfise/parsing_error.hpp"
 #include "viennautils/dfise/primary_reader.hpp"
+#include "viennautils/dfise/snapshot.hpp"
 
 namespace viennautils
 {
 namespace dfise
 {
 
-grd_bnd_reader::grd_bnd_reader(std::string const & filename)
+index_type const grd_bnd_reader::invalid_index;
+
+namespace
+{
+
+//the number of values that follow the tag of an element (polygons are followed by their number of edges first)
+unsigned int element_value_count(grd_bnd_reader::element_tag tag)
 {
-  primary_reader preader( filename
-                        , boost::bind(&grd_bnd_reader::parse_additional_info, this, _1)
-                        , boost::bind(&grd_bnd_reader::parse_data_block, this, _1)
-                        );
+  switch (tag)
+  {
+    case grd_bnd_reader::element_tag_line:          return 2; //vertices
+    case grd_bnd_reader::element_tag_triangle:      return 3; //edges
+    case grd_bnd_reader::element_tag_quadrilateral: return 4; //edges
+    case grd_bnd_reader::element_tag_polygon:       return 0;
+    case grd_bnd_reader::element_tag_tetrahedron:   return 4; //faces
+  }
+  return 0;
+}
+
+} //end of anonymous namespace
+
+grd_bnd_reader::grd_bnd_reader( std::string const & filename
+                              , read_mode mode
+                              )
+                              : temporaries_(0)
+                              , peak_bytes_(0)
+                              , buckets_assembled_(false)
+{
+  parse(input_source::file(filename), mode);
+}
+
+grd_bnd_reader::grd_bnd_reader( std::string const & filename
+                              , std::string const & snapshot_path
+                              , read_mode mode
+                              )
+                              : temporaries_(0)
+                              , peak_bytes_(0)
+                              , buckets_assembled_(false)
+{
+  {
+    snapshot_reader sreader;
+    if (sreader.open(snapshot_path, filename, snapshot_kind_grid))
+    {
+      if (load_snapshot(sreader))
+      {
+        peak_bytes_ = get_memory_usage().total_bytes();
+        return;
+      }
+      //discard whatever was restored from the broken snapshot
+      vertices_.clear();
+      connectivity_ = element_connectivity();
+      regions_.clear();
+      trans_matrix_.clear();
+      trans_move_.clear();
+    }
+  }
   
-  edges_.clear();
+  parse(input_source::file(filename), mode);
+  
+  //failing to write the snapshot (e.g. in a read-only directory) is not an error, the file just has to be parsed again next time
+  try
+  {
+    snapshot_writer swriter(snapshot_path, filename, snapshot_kind_grid);
+    save_snapshot(swriter);
+    swriter.commit();
+  }
+  catch (parsing_error const &)
+  {
+  }
+}
+
+grd_bnd_reader::grd_bnd_reader( input_source const & source
+                              , read_mode mode
+                              )
+                              : temporaries_(0)
+                              , peak_bytes_(0)
+                              , buckets_assembled_(false)
+{
+  parse(source, mode);
+}
+
+grd_bnd_reader::grd_bnd_reader( std::string const & filename
+                              , region_selection const & selection
+                              )
+                              : temporaries_(0)
+                              , peak_bytes_(0)
+                              , buckets_assembled_(false)
+{
+  parse(input_source::file(filename), read_mode_direct, &selection);
+}
+
+grd_bnd_reader::grd_bnd_reader( input_source const & source
+                              , region_selection const & selection
+                              )
+                              : temporaries_(0)
+                              , peak_bytes_(0)
+                              , buckets_assembled_(false)
+{
+  parse(source, read_mode_direct, &selection);
+}
+
+void grd_bnd_reader::parse(input_source const & source, read_mode mode, region_selection const * selection)
+{
+  parse_temporaries temporaries;
+  temporaries.selection_ = selection;
+  temporaries_ = &temporaries;
+  peak_bytes_ = 0;
+  try
+  {
+    //a selection seeks back to the Vertices and Elements blocks
+    primary_reader preader( source
+                          , boost::bind(&grd_bnd_reader::parse_additional_info, this, _1)
+                          , boost::bind(&grd_bnd_reader::parse_data_block, this, _1)
+                          , mode
+                          , selection ? access_mode_random : access_mode_sequential
+                          );
+  }
+  catch (...)
+  {
+    temporaries_ = 0;
+    throw;
+  }
+  temporaries_ = 0;
+}
+
+void grd_bnd_reader::update_peak_bytes(primary_reader const & preader)
+{
+  std::size_t bytes = get_memory_usage().total_bytes() + preader.get_buffered_bytes();
+  if (temporaries_ != 0)
+  {
+    bytes += heap_bytes(temporaries_->info_.regions_) + heap_bytes(temporaries_->info_.materials_)
+           + heap_bytes(temporaries_->edges_) + heap_bytes(temporaries_->faces_);
+  }
+  if (bytes > peak_bytes_)
+  {
+    peak_bytes_ = bytes;
+  }
+}
+
+bool grd_bnd_reader::load_snapshot(snapshot_reader & sreader)
+{
+  boost::uint64_t file_type;
+  boost::uint64_t dimension;
+  boost::uint64_t region_count;
+  if (  !sreader.read(file_type) || !sreader.read(dimension)
+     || !sreader.read(vertices_)
+     || !sreader.read(connectivity_.tags_) || !sreader.read(connectivity_.offsets_) || !sreader.read(connectivity_.vertex_indices_)
+     || !sreader.read(trans_matrix_) || !sreader.read(trans_move_)
+     || !sreader.read(region_count)
+     )
+  {
+    return false;
+  }
+  filetype_ = static_cast<filetype>(file_type);
+  dimension_ = static_cast<unsigned int>(dimension);
+  
+  regions_.clear();
+  for (boost::uint64_t i = 0; i < region_count; ++i)
+  {
+    std::string name;
+    if (!sreader.read(name))
+    {
+      return false;
+    }
+    region & r = regions_[name];
+    if (!sreader.read(r.material_) || !sreader.read(r.element_indices_))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void grd_bnd_reader::save_snapshot(snapshot_writer & swriter) const
+{
+  swriter.write(static_cast<boost::uint64_t>(filetype_));
+  swriter.write(static_cast<boost::uint64_t>(dimension_));
+  swriter.write(vertices_);
+  swriter.write(connectivity_.tags_);
+  swriter.write(connectivity_.offsets_);
+  swriter.write(connectivity_.vertex_indices_);
+  swriter.write(trans_matrix_);
+  swriter.write(trans_move_);
+  swriter.write(static_cast<boost::uint64_t>(regions_.size()));
+  for (RegionMap::const_iterator it = regions_.begin(); it != regions_.end(); ++it)
+  {
+    swriter.write(it->first);
+    swriter.write(it->second.material_);
+    swriter.write(it->second.element_indices_);
+  }
+}
+
+grd_bnd_reader::ElementVector const & grd_bnd_reader::get_elements() const
+{
+  //the reader might be shared by several threads (e.g. data_reader::read_many), the first of them assembles the view
+  #pragma omp critical (viennautils_dfise_grd_bnd_reader_elements)
+  {
+    if (elements_.size() != connectivity_.size())
+    {
+      elements_.resize(connectivity_.size());
+      for (ElementIndex i = 0; i < elements_.size(); ++i)
+      {
+        elements_[i].tag_ = connectivity_.tag(i);
+        elements_[i].vertex_indices_.assign(connectivity_.vertices_begin(i), connectivity_.vertices_end(i));
+      }
+    }
+  }
+  return elements_;
+}
+
+unsigned int grd_bnd_reader::element_buckets::arity(element_tag tag)
+{
+  switch (tag)
+  {
+    case element_tag_line:          return 2;
+    case element_tag_triangle:      return 3;
+    case element_tag_quadrilateral: return 4;
+    case element_tag_polygon:       return 0;
+    case element_tag_tetrahedron:   return 4;
+  }
+  return 0;
+}
+
+grd_bnd_reader::element_buckets::SlotRange grd_bnd_reader::element_buckets::region_slots(std::string const & region_name, element_tag tag) const
+{
+  std::map<std::string, SlotRanges>::const_iterator it = region_slots_.find(region_name);
+  if (it == region_slots_.end())
+  {
+    return SlotRange(0, 0);
+  }
+  return it->second[bucket_index(tag)];
+}
+
+memory_usage grd_bnd_reader::get_memory_usage() const
+{
+  memory_usage usage;
+  usage.add("vertices", heap_bytes(vertices_));
+  usage.add("element connectivity", heap_bytes(connectivity_.tags_) + heap_bytes(connectivity_.offsets_) + heap_bytes(connectivity_.vertex_indices_));
+  
+  std::size_t region_bytes = 0;
+  for (RegionMap::const_iterator it = regions_.begin(); it != regions_.end(); ++it)
+  {
+    region_bytes += map_node_bytes(regions_) + heap_bytes(it->first) + heap_bytes(it->second.material_) + heap_bytes(it->second.element_indices_);
+  }
+  usage.add("regions", region_bytes);
+  usage.add("transformation", heap_bytes(trans_matrix_) + heap_bytes(trans_move_));
+  usage.add("vertex and element maps", heap_bytes(vertex_map_) + heap_bytes(element_map_) + heap_bytes(skipped_regions_));
+  
+  std::size_t element_bytes = heap_bytes(elements_);
+  for (ElementVector::const_iterator it = elements_.begin(); it != elements_.end(); ++it)
+  {
+    element_bytes += heap_bytes(it->vertex_indices_);
+  }
+  usage.add("elements", element_bytes);
+  
+  std::size_t bucket_bytes = heap_bytes(buckets_.polygon_offsets_) + heap_bytes(buckets_.element_tags_) + heap_bytes(buckets_.element_slots_);
+  for (std::size_t b = 0; b < element_buckets::bucket_count; ++b)
+  {
+    bucket_bytes += heap_bytes(buckets_.vertex_indices_[b]) + heap_bytes(buckets_.elements_[b]);
+  }
+  for (std::map<std::string, element_buckets::SlotRanges>::const_iterator it = buckets_.region_slots_.begin(); it != buckets_.region_slots_.end(); ++it)
+  {
+    bucket_bytes += map_node_bytes(buckets_.region_slots_) + heap_bytes(it->first);
+  }
+  usage.add("element buckets", bucket_bytes);
+  
+  usage.peak_bytes_ = peak_bytes_;
+  return usage;
+}
+
+grd_bnd_reader::element_buckets const & grd_bnd_reader::get_element_buckets() const
+{
+  //just like get_elements, the first of several threads sharing the reader assembles the buckets
+  #pragma omp critical (viennautils_dfise_grd_bnd_reader_buckets)
+  {
+    //a flag rather than comparing sizes, an empty grid has buckets as well (with polygon_offsets_ == {0})
+    if (!buckets_assembled_)
+    {
+      buckets_ = element_buckets();
+      
+      //exact unless elements belong to more than one region
+      boost::array<std::size_t, element_buckets::bucket_count> vertex_counts = {{0}};
+      for (ElementIndex i = 0; i < connectivity_.size(); ++i)
+      {
+        vertex_counts[element_buckets::bucket_index(connectivity_.tag(i))] += connectivity_.vertex_count(i);
+      }
+      for (std::size_t b = 0; b < element_buckets::bucket_count; ++b)
+      {
+        element_tag tag = static_cast<element_tag>(b + 1);
+        buckets_.vertex_indices_[b].reserve(vertex_counts[b]);
+        buckets_.elements_[b].reserve(element_buckets::arity(tag) ? vertex_counts[b] / element_buckets::arity(tag) : 0);
+      }
+      buckets_.polygon_offsets_.push_back(0);
+      buckets_.element_tags_.resize(connectivity_.size());
+      buckets_.element_slots_.resize(connectivity_.size());
+      
+      //every bucket is filled in slot order, so the slots of a region are simply those added while handling the region
+      std::vector<bool> assigned(connectivity_.size(), false);
+      for (RegionMap::const_iterator it = regions_.begin(); it != regions_.end(); ++it)
+      {
+        element_buckets::SlotRanges & ranges = buckets_.region_slots_[it->first];
+        for (std::size_t b = 0; b < element_buckets::bucket_count; ++b)
+        {
+          ranges[b].first = static_cast<element_buckets::Slot>(buckets_.elements_[b].size());
+        }
+        for (std::vector<ElementIndex>::const_iterator element = it->second.element_indices_.begin(); element != it->second.element_indices_.end(); ++element)
+        {
+          add_to_bucket(*element, !assigned[*element]);
+          assigned[*element] = true;
+        }
+        for (std::size_t b = 0; b < element_buckets::bucket_count; ++b)
+        {
+          ranges[b].second = static_cast<element_buckets::Slot>(buckets_.elements_[b].size());
+        }
+      }
+      
+      for (std::size_t b = 0; b < element_buckets::bucket_count; ++b)
+      {
+        buckets_.unassigned_slots_[b].first = static_cast<element_buckets::Slot>(buckets_.elements_[b].size());
+      }
+      for (ElementIndex i = 0; i < connectivity_.size(); ++i)
+      {
+        if (!assigned[i])
+        {
+          add_to_bucket(i, true);
+        }
+      }
+      for (std::size_t b = 0; b < element_buckets::bucket_count; ++b)
+      {
+        buckets_.unassigned_slots_[b].second = static_cast<element_buckets::Slot>(buckets_.elements_[b].size());
+      }
+      buckets_assembled_ = true;
+    }
+  }
+  return buckets_;
+}
+
+void grd_bnd_reader::add_to_bucket(ElementIndex element, bool first_slot) const
+{
+  element_tag tag = connectivity_.tag(element);
+  std::size_t b = element_buckets::bucket_index(tag);
+  element_buckets::Slot slot = static_cast<element_buckets::Slot>(buckets_.elements_[b].size());
+  buckets_.elements_[b].push_back(element);
+  buckets_.vertex_indices_[b].insert(buckets_.vertex_indices_[b].end(), connectivity_.vertices_begin(element), connectivity_.vertices_end(element));
+  if (tag == element_tag_polygon)
+  {
+    buckets_.polygon_offsets_.push_back(static_cast<element_connectivity::Offset>(buckets_.vertex_indices_[b].size()));
+  }
+  if (first_slot)
+  {
+    buckets_.element_tags_[element] = static_cast<unsigned char>(tag);
+    buckets_.element_slots_[element] = slot;
+  }
 }
 
 void grd_bnd_reader::parse_additional_info(primary_reader & preader)
@@ -39,23 +388,139 @@ void grd_bnd_reader::parse_additional_info(primary_reader & preader)
   
   dimension_ = preader.get_mandatory_info().dimension_;
   
-  preader.read_array("regions", grd_bnd_info_.regions_);
-  preader.read_array("materials", grd_bnd_info_.materials_);
+  preader.read_array("regions", temporaries_->info_.regions_);
+  preader.read_array("materials", temporaries_->info_.materials_);
+  temporaries_->regions_.resize(temporaries_->info_.regions_.size());
 }
 
 void grd_bnd_reader::parse_data_block(primary_reader & preader)
 {
+  if (temporaries_->selection_ != 0)
+  {
+    parse_selected_data_block(preader);
+    return;
+  }
+  
   preader.read_block              ("CoordSystem", boost::bind(&grd_bnd_reader::parse_coord_system_block, this, boost::ref(preader)));
   preader.read_block<unsigned int>("Vertices",    boost::bind(&grd_bnd_reader::parse_vertices_block,     this, boost::ref(preader), _1));
   preader.read_block<unsigned int>("Edges",       boost::bind(&grd_bnd_reader::parse_edges_block,        this, boost::ref(preader), _1));
   preader.read_block<unsigned int>("Faces",       boost::bind(&grd_bnd_reader::parse_faces_block,        this, boost::ref(preader), _1));
-  preader.read_block<unsigned int>("Locations",   boost::bind(&grd_bnd_reader::parse_locations_block,    this, boost::ref(preader), _1));
+  update_peak_bytes(preader);
+  //the locations are not needed, the block is merely scanned for its end
+  preader.skip_block("Locations");
   preader.read_block<unsigned int>("Elements",    boost::bind(&grd_bnd_reader::parse_elements_block,     this, boost::ref(preader), _1));
+  update_peak_bytes(preader);
+  
+  //the regions only refer to elements, edges and faces are not needed any longer
+  EdgeVector().swap(temporaries_->edges_);
+  FaceVector().swap(temporaries_->faces_);
+  
+  std::vector<bool> const selected(temporaries_->info_.regions_.size(), true);
+  preader.read_blocks("Region", selected.size(), boost::bind(&grd_bnd_reader::read_region_block, this, _1, boost::cref(selected), _2));
+  merge_regions(selected);
+  update_peak_bytes(preader);
+}
+
+//the Region blocks follow the Elements block, thus Vertices and Elements are skipped at first and read once it is known
+//which of their entries are needed
+void grd_bnd_reader::parse_selected_data_block(primary_reader & preader)
+{
+  preader.read_block              ("CoordSystem", boost::bind(&grd_bnd_reader::parse_coord_system_block, this, boost::ref(preader)));
+  std::size_t const vertices_offset = preader.tell();
+  preader.skip_block("Vertices");
+  preader.read_block<unsigned int>("Edges",       boost::bind(&grd_bnd_reader::parse_edges_block,        this, boost::ref(preader), _1));
+  preader.read_block<unsigned int>("Faces",       boost::bind(&grd_bnd_reader::parse_faces_block,        this, boost::ref(preader), _1));
+  preader.skip_block("Locations");
+  std::size_t const elements_offset = preader.tell();
+  preader.skip_block("Elements");
+  
+  std::vector<bool> const selected = select_regions(*temporaries_->selection_);
+  preader.read_blocks("Region", selected.size(), boost::bind(&grd_bnd_reader::read_region_block, this, _1, boost::cref(selected), _2));
+  merge_regions(selected);
+  std::size_t const end_offset = preader.tell();
+  update_peak_bytes(preader);
+  
+  element_map_.assign(preader.get_mandatory_info().nb_elements_, invalid_index);
+  for (RegionMap::const_iterator it = regions_.begin(); it != regions_.end(); ++it)
+  {
+    for (std::vector<ElementIndex>::const_iterator element = it->second.element_indices_.begin(); element != it->second.element_indices_.end(); ++element)
+    {
+      element_map_[*element] = 0;
+    }
+  }
+  compact_index_map(element_map_);
+  for (RegionMap::iterator it = regions_.begin(); it != regions_.end(); ++it)
+  {
+    for (std::vector<ElementIndex>::iterator element = it->second.element_indices_.begin(); element != it->second.element_indices_.end(); ++element)
+    {
+      *element = element_map_[*element];
+    }
+  }
+  
+  preader.seek(elements_offset);
+  preader.read_block<unsigned int>("Elements",    boost::bind(&grd_bnd_reader::parse_elements_block,     this, boost::ref(preader), _1));
+  update_peak_bytes(preader);
+  EdgeVector().swap(temporaries_->edges_);
+  FaceVector().swap(temporaries_->faces_);
+  
+  vertex_map_.assign(preader.get_mandatory_info().nb_vertices_, invalid_index);
+  for (std::vector<VertexIndex>::const_iterator vertex = connectivity_.vertex_indices_.begin(); vertex != connectivity_.vertex_indices_.end(); ++vertex)
+  {
+    vertex_map_[*vertex] = 0;
+  }
+  compact_index_map(vertex_map_);
+  for (std::vector<VertexIndex>::iterator vertex = connectivity_.vertex_indices_.begin(); vertex != connectivity_.vertex_indices_.end(); ++vertex)
+  {
+    *vertex = vertex_map_[*vertex];
+  }
+  
+  preader.seek(vertices_offset);
+  preader.read_block<unsigned int>("Vertices",    boost::bind(&grd_bnd_reader::parse_vertices_block,     this, boost::ref(preader), _1));
+  
+  preader.seek(end_offset);
+  update_peak_bytes(preader);
+}
+
+std::vector<bool> grd_bnd_reader::select_regions(region_selection const & selection)
+{
+  std::vector<std::string> const & names = temporaries_->info_.regions_;
+  std::vector<std::string> const & materials = temporaries_->info_.materials_;
+  for (std::vector<std::string>::const_iterator it = selection.regions_.begin(); it != selection.regions_.end(); ++it)
+  {
+    if (std::find(names.begin(), names.end(), *it) == names.end())
+    {
+      throw make_exception<parsing_error>("selected region does not exist: " + *it);
+    }
+  }
+  for (std::vector<std::string>::const_iterator it = selection.materials_.begin(); it != selection.materials_.end(); ++it)
+  {
+    if (std::find(materials.begin(), materials.end(), *it) == materials.end())
+    {
+      throw make_exception<parsing_error>("no region of selected material: " + *it);
+    }
+  }
   
-  for (std::vector<std::string>::size_type i = 0; i < grd_bnd_info_.regions_.size(); ++i)
+  std::vector<bool> selected(names.size());
+  for (std::vector<std::string>::size_type i = 0; i < names.size(); ++i)
   {
-    preader.read_block<std::string>("Region",     boost::bind(&grd_bnd_reader::parse_region_block,       this, boost::ref(preader), i, _1));
+    selected[i] =  std::find(selection.regions_.begin(), selection.regions_.end(), names[i]) != selection.regions_.end()
+                || (i < materials.size() && std::find(selection.materials_.begin(), selection.materials_.end(), materials[i]) != selection.materials_.end());
+    if (!selected[i])
+    {
+      skipped_regions_.push_back(names[i]);
+    }
   }
+  return selected;
+}
+
+index_type grd_bnd_reader::compact_index_map(std::vector<index_type> & map)
+{
+  index_type count = 0;
+  for (std::vector<index_type>::iterator it = map.begin(); it != map.end(); ++it)
+  {
+    *it = (*it == invalid_index) ? invalid_index : count++;
+  }
+  return count;
 }
 
 void grd_bnd_reader::parse_coord_system_block(primary_reader & preader)
@@ -71,10 +536,37 @@ void grd_bnd_reader::parse_vertices_block(primary_reader & preader, unsigned int
     throw viennautils::make_exception<parsing_error>("number of vertices in Info block and Vertices block does not match");
   }
 
-  vertices_.resize(preader.get_mandatory_info().nb_vertices_ * preader.get_mandatory_info().dimension_);
-  for (VertexIndex i = 0; i < vertices_.size(); ++i)
+  if (vertex_map_.empty())
   {
-    preader.read_value(vertices_[i]);
+    vertices_.resize(preader.get_mandatory_info().nb_vertices_ * preader.get_mandatory_info().dimension_);
+    if (!vertices_.empty())
+    {
+      preader.read_values(&vertices_[0], vertices_.size());
+    }
+    return;
+  }
+  
+  //the coordinates are read in batches of vertices, only those of mapped vertices are kept
+  std::size_t const batch_size = 4096;
+  std::size_t loaded = 0;
+  for (std::vector<VertexIndex>::const_iterator vertex = vertex_map_.begin(); vertex != vertex_map_.end(); ++vertex)
+  {
+    loaded += (*vertex != invalid_index);
+  }
+  vertices_.resize(loaded * dimension_);
+  std::vector<double> batch(batch_size * dimension_);
+  for (std::size_t begin = 0; begin < vertex_map_.size(); begin += batch_size)
+  {
+    std::size_t count = std::min(batch_size, vertex_map_.size() - begin);
+    preader.read_values(&batch[0], count * dimension_);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      VertexIndex mapped = vertex_map_[begin + i];
+      if (mapped != invalid_index)
+      {
+        std::copy(&batch[i * dimension_], &batch[i * dimension_] + dimension_, &vertices_[static_cast<std::size_t>(mapped) * dimension_]);
+      }
+    }
   }
 }
 
@@ -85,11 +577,11 @@ void grd_bnd_reader::parse_edges_block(primary_reader & preader, unsigned int co
     throw viennautils::make_exception<parsing_error>("number of edges in Info block and Edges block does not match");
   }
   
-  edges_.resize(preader.get_mandatory_info().nb_edges_);
-  for(std::vector<Edge>::size_type i = 0; i < edges_.size(); ++i)
+  temporaries_->edges_.resize(preader.get_mandatory_info().nb_edges_);
+  for(std::vector<Edge>::size_type i = 0; i < temporaries_->edges_.size(); ++i)
   {
-    read_vertex_index(preader, edges_[i][0]);
-    read_vertex_index(preader, edges_[i][1]);
+    read_vertex_index(preader, temporaries_->edges_[i][0]);
+    read_vertex_index(preader, temporaries_->edges_[i][1]);
   }
 }
 
@@ -100,8 +592,8 @@ void grd_bnd_reader::parse_faces_block(primary_reader & preader, unsigned int co
     throw viennautils::make_exception<parsing_error>("number of faces in Info block and Faces block does not match");
   }
   
-  faces_.resize(preader.get_mandatory_info().nb_faces_);
-  for(std::vector<Face>::size_type i = 0; i < faces_.size(); ++i)
+  temporaries_->faces_.resize(preader.get_mandatory_info().nb_faces_);
+  for(std::vector<Face>::size_type i = 0; i < temporaries_->faces_.size(); ++i)
   {
     int number_of_edges;
     preader.read_value(number_of_edges);
@@ -110,18 +602,9 @@ void grd_bnd_reader::parse_faces_block(primary_reader & preader, unsigned int co
       throw viennautils::make_exception<parsing_error>( "face with " + boost::lexical_cast<std::string>(number_of_edges) + " edges found"
                                                       + ", however only triangular faces (with 3 edges) are supported right now");
     }
-    read_edge_index(preader, faces_[i][0]);
-    read_edge_index(preader, faces_[i][1]);
-    read_edge_index(preader, faces_[i][2]);
-  }
-}
-
-void grd_bnd_reader::parse_locations_block(primary_reader & preader, unsigned int const & para)
-{
-  std::string ignore;
-  for (unsigned int i = 0; i < para; ++i)
-  {
-    preader.read_value(ignore);
+    read_edge_index(preader, temporaries_->faces_[i][0]);
+    read_edge_index(preader, temporaries_->faces_[i][1]);
+    read_edge_index(preader, temporaries_->faces_[i][2]);
   }
 }
 
@@ -132,8 +615,26 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
     throw viennautils::make_exception<parsing_error>("number of elements in Info block and Elements block does not match");
   }
   
-  elements_.resize(preader.get_mandatory_info().nb_elements_);
-  for (std::vector<element>::size_type i = 0; i < elements_.size(); ++i)
+  std::vector<unsigned char> & tags = connectivity_.tags_;
+  std::vector<element_connectivity::Offset> & offsets = connectivity_.offsets_;
+  std::vector<VertexIndex> & vertex_indices = connectivity_.vertex_indices_;
+  
+  //with a region_selection only the elements that are mapped are decoded, the values of the others are just skipped
+  ElementIndex const element_count = preader.get_mandatory_info().nb_elements_;
+  ElementIndex kept = element_count;
+  if (!element_map_.empty())
+  {
+    kept = static_cast<ElementIndex>(element_map_.size() - std::count(element_map_.begin(), element_map_.end(), invalid_index));
+  }
+  
+  tags.resize(kept);
+  offsets.resize(tags.size() + 1);
+  offsets[0] = 0;
+  vertex_indices.clear();
+  //exact for simplices of the grid dimension which are by far the most common elements
+  vertex_indices.reserve(tags.size() * (dimension_ + 1));
+  ElementIndex n = 0;
+  for (ElementIndex i = 0; i < element_count; ++i)
   {
     unsigned int tag_value;
     preader.read_value(tag_value);
@@ -147,15 +648,27 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
       throw viennautils::make_exception<parsing_error>("encountered unsupported element tag value: " + boost::lexical_cast<std::string>(tag_value));
     }
     
-    elements_[i].tag_ = static_cast<element_tag>(tag_value);
-    switch (elements_[i].tag_)
+    if (!element_map_.empty() && element_map_[i] == invalid_index)
+    {
+      unsigned int value_count = element_value_count(static_cast<element_tag>(tag_value));
+      if (tag_value == element_tag_polygon)
+      {
+        preader.read_value(value_count);
+      }
+      preader.skip_values(value_count);
+      continue;
+    }
+    
+    switch (static_cast<element_tag>(tag_value))
     {
       case element_tag_line:
       {
         //line given by two vertices
-        elements_[i].vertex_indices_.resize(2);
-        read_vertex_index(preader, elements_[i].vertex_indices_[0]);
-        read_vertex_index(preader, elements_[i].vertex_indices_[1]);
+        VertexIndex vertex_index;
+        read_vertex_index(preader, vertex_index);
+        vertex_indices.push_back(vertex_index);
+        read_vertex_index(preader, vertex_index);
+        vertex_indices.push_back(vertex_index);
         break;
       }
       case element_tag_triangle:
@@ -165,12 +678,12 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
         
         //first edge
         read_edge_index(preader, edge_index);
-        elements_[i].vertex_indices_.push_back(get_oriented_edge_vertex(edge_index, 0));
-        elements_[i].vertex_indices_.push_back(get_oriented_edge_vertex(edge_index, 1));
+        vertex_indices.push_back(get_oriented_edge_vertex(edge_index, 0));
+        vertex_indices.push_back(get_oriented_edge_vertex(edge_index, 1));
         
         //second edge
         read_edge_index(preader, edge_index);
-        elements_[i].vertex_indices_.push_back(get_oriented_edge_vertex(edge_index, 1));
+        vertex_indices.push_back(get_oriented_edge_vertex(edge_index, 1));
         
         //ignore third edge - we already have all 3 vertices
         read_edge_index(preader, edge_index);
@@ -183,16 +696,16 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
         
         //first edge
         read_edge_index(preader, edge_index);
-        elements_[i].vertex_indices_.push_back(get_oriented_edge_vertex(edge_index, 0));
-        elements_[i].vertex_indices_.push_back(get_oriented_edge_vertex(edge_index, 1));
+        vertex_indices.push_back(get_oriented_edge_vertex(edge_index, 0));
+        vertex_indices.push_back(get_oriented_edge_vertex(edge_index, 1));
         
         //ignore second edge
         read_edge_index(preader, edge_index);
         
         //thrid edge
         read_edge_index(preader, edge_index);
-        elements_[i].vertex_indices_.push_back(get_oriented_edge_vertex(edge_index, 0));
-        elements_[i].vertex_indices_.push_back(get_oriented_edge_vertex(edge_index, 1));
+        vertex_indices.push_back(get_oriented_edge_vertex(edge_index, 0));
+        vertex_indices.push_back(get_oriented_edge_vertex(edge_index, 1));
         
         //ignore last edge
         read_edge_index(preader, edge_index);
@@ -203,14 +716,13 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
         //read number of edges
         unsigned int number_of_edges;
         preader.read_value(number_of_edges);
-        elements_[i].vertex_indices_.reserve(number_of_edges);
         
         for (unsigned int j = 0; j < number_of_edges; ++j)
         {
           //read one edge at a time and add the first vertex of the edge to the polygon
           int edge_index;
           read_edge_index(preader, edge_index);
-          elements_[i].vertex_indices_.push_back(get_oriented_edge_vertex(edge_index, 0));
+          vertex_indices.push_back(get_oriented_edge_vertex(edge_index, 0));
         }
         break;
       }
@@ -219,9 +731,11 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
         int face_index;
         //first face
         read_face_index(preader, face_index);
-        elements_[i].vertex_indices_.push_back(get_oriented_face_vertex(face_index, 0, 0));
-        elements_[i].vertex_indices_.push_back(get_oriented_face_vertex(face_index, 0, 1));
-        elements_[i].vertex_indices_.push_back(get_oriented_face_vertex(face_index, 1, 1));
+        boost::array<VertexIndex,3> first_face;
+        first_face[0] = get_oriented_face_vertex(face_index, 0, 0);
+        first_face[1] = get_oriented_face_vertex(face_index, 0, 1);
+        first_face[2] = get_oriented_face_vertex(face_index, 1, 1);
+        vertex_indices.insert(vertex_indices.end(), first_face.begin(), first_face.end());
         
         //second face (find the last, missing vertex of the tetrahedron in the second face)
         int face_index2;
@@ -232,9 +746,9 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
         candidates[2] = get_oriented_face_vertex(face_index2, 1, 1);
         
         VertexVector::size_type missing_vertex = 0;
-        for (;  missing_vertex < candidates.size() && (  candidates[missing_vertex] == elements_[i].vertex_indices_[0]
-                                                      || candidates[missing_vertex] == elements_[i].vertex_indices_[1]
-                                                      || candidates[missing_vertex] == elements_[i].vertex_indices_[2]
+        for (;  missing_vertex < candidates.size() && (  candidates[missing_vertex] == first_face[0]
+                                                      || candidates[missing_vertex] == first_face[1]
+                                                      || candidates[missing_vertex] == first_face[2]
                                                       )
              ; ++missing_vertex
             );
@@ -245,9 +759,9 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
                                                           + "\nfirst face index: " + boost::lexical_cast<std::string>(face_index)
                                                           + "\nsecond face index: " + boost::lexical_cast<std::string>(face_index2)
                                                           + "\nvertex indices of first face:"
-                                                          + "\n" + boost::lexical_cast<std::string>(elements_[i].vertex_indices_[0])
-                                                          + "\n" + boost::lexical_cast<std::string>(elements_[i].vertex_indices_[1])
-                                                          + "\n" + boost::lexical_cast<std::string>(elements_[i].vertex_indices_[2])
+                                                          + "\n" + boost::lexical_cast<std::string>(first_face[0])
+                                                          + "\n" + boost::lexical_cast<std::string>(first_face[1])
+                                                          + "\n" + boost::lexical_cast<std::string>(first_face[2])
                                                           + "\nvertex indices of second face: "
                                                           + "\n" + boost::lexical_cast<std::string>(candidates[0])
                                                           + "\n" + boost::lexical_cast<std::string>(candidates[1])
@@ -255,7 +769,7 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
                                                           );
         }
         
-        elements_[i].vertex_indices_.push_back(candidates[missing_vertex]);
+        vertex_indices.push_back(candidates[missing_vertex]);
         
         //ignore remaining two faces (we should have all the vertices we need)
         read_face_index(preader, face_index);
@@ -264,12 +778,42 @@ void grd_bnd_reader::parse_elements_block(primary_reader & preader, unsigned int
       }
       //all possible enum values have to be implemented! warning should alert to missing enum values
     }
+    check_index_range(vertex_indices.size(), "element vertex references");
+    tags[n] = static_cast<unsigned char>(tag_value);
+    offsets[++n] = static_cast<element_connectivity::Offset>(vertex_indices.size());
+  }
+}
+
+void grd_bnd_reader::read_region_block(primary_reader & preader, std::vector<bool> const & selected, std::vector<std::string>::size_type region_index)
+{
+  if (selected[region_index])
+  {
+    preader.read_block<std::string>("Region", boost::bind(&grd_bnd_reader::parse_region_block, this, boost::ref(preader), region_index, _1));
+  }
+  else
+  {
+    preader.skip_block("Region");
+  }
+}
+
+void grd_bnd_reader::merge_regions(std::vector<bool> const & selected)
+{
+  //in Info block order, i.e. the last of equally named regions wins just as if they were parsed one after another
+  for (std::vector<std::string>::size_type i = 0; i < selected.size(); ++i)
+  {
+    if (selected[i])
+    {
+      region & r = regions_[temporaries_->info_.regions_[i]];
+      r.material_.swap(temporaries_->regions_[i].material_);
+      r.element_indices_.swap(temporaries_->regions_[i].element_indices_);
+    }
   }
+  std::vector<region>().swap(temporaries_->regions_);
 }
 
 void grd_bnd_reader::parse_region_block(primary_reader & preader, std::vector<std::string>::size_type region_index, std::string const & para)
 {
-  std::string const & region_name = grd_bnd_info_.regions_[region_index];
+  std::string const & region_name = temporaries_->info_.regions_[region_index];
   if (para != region_name)
   {
     throw make_exception<parsing_error>("unexpected region name: " + para + " - expected name: " + region_name);
@@ -279,11 +823,11 @@ void grd_bnd_reader::parse_region_block(primary_reader & preader, std::vector<st
   {
     std::string material;
     preader.read_attribute("material", material);
-    if (material != grd_bnd_info_.materials_[region_index])
+    if (material != temporaries_->info_.materials_[region_index])
     {
       throw make_exception<parsing_error>("material parameter does not match Info block");
     }
-    regions_[region_name].material_ = grd_bnd_info_.materials_[region_index];
+    temporaries_->regions_[region_index].material_ = temporaries_->info_.materials_[region_index];
 
     preader.read_block<std::vector<ElementIndex>::size_type>("Elements", boost::bind(&grd_bnd_reader::parse_region_element_block, this, boost::ref(preader), region_index, _1));
   }
@@ -295,27 +839,38 @@ void grd_bnd_reader::parse_region_block(primary_reader & preader, std::vector<st
 
 void grd_bnd_reader::parse_region_element_block(primary_reader & preader, std::vector<std::string>::size_type region_index, std::vector<ElementIndex>::size_type const & para)
 {
-  std::vector<ElementIndex>& region_elements = regions_[grd_bnd_info_.regions_[region_index]].element_indices_;
+  std::vector<ElementIndex>& region_elements = temporaries_->regions_[region_index].element_indices_;
   region_elements.resize(para);
   for (std::vector<ElementIndex>::size_type i = 0; i < region_elements.size(); ++i)
   {
     preader.read_value(region_elements[i]);
-    if (region_elements[i] >= elements_.size())
+    if (region_elements[i] >= preader.get_mandatory_info().nb_elements_)
     {
       throw make_exception<parsing_error>("element index out of bounds: " + boost::lexical_cast<std::string>(region_elements[i])
-                                         + " max: " + boost::lexical_cast<std::string>(elements_.size()-1)
+                                         + " max: " + boost::lexical_cast<std::string>(preader.get_mandatory_info().nb_elements_-1)
                                          );
     }
   }
 }
 
+void grd_bnd_reader::check_index_range(std::size_t count, std::string const & what)
+{
+  if (count > std::numeric_limits<index_type>::max())
+  {
+    throw make_exception<parsing_error>( "number of " + what + " (" + boost::lexical_cast<std::string>(count) + ")"
+                                       + " exceeds the range of the " + boost::lexical_cast<std::string>(sizeof(index_type)*8) + " bit index type"
+                                       + " - rebuild with VIENNAUTILS_DFISE_64BIT_INDICES"
+                                       );
+  }
+}
+
 void grd_bnd_reader::read_vertex_index(primary_reader & preader, VertexIndex & index)
 {
   preader.read_value(index);
-  if (index >= vertices_.size()/dimension_)
+  if (index >= preader.get_mandatory_info().nb_vertices_)
   {
     throw make_exception<parsing_error>( "vertex index out of bounds: " + boost::lexical_cast<std::string>(index)
-                                       + " max: " + boost::lexical_cast<std::string>(vertices_.size()/dimension_-1)
+                                       + " max: " + boost::lexical_cast<std::string>(preader.get_mandatory_info().nb_vertices_-1)
                                        );
   }
 }
@@ -324,11 +879,11 @@ void grd_bnd_reader::read_edge_index(primary_reader & preader, int & index)
 {
   preader.read_value(index);
   EdgeVector::size_type actual_edge_index = (index < 0 ? -index-1 : index);
-  if (actual_edge_index >= edges_.size())
+  if (actual_edge_index >= temporaries_->edges_.size())
   {
     throw make_exception<parsing_error>( "edge index out of bounds: " + boost::lexical_cast<std::string>(index)
                                        + " turns into actual edge index of: " + boost::lexical_cast<std::string>(actual_edge_index)
-                                       + " max: " + boost::lexical_cast<std::string>(edges_.size()-1)
+                                       + " max: " + boost::lexical_cast<std::string>(temporaries_->edges_.size()-1)
                                        );
   }
 }
@@ -337,11 +892,11 @@ void grd_bnd_reader::read_face_index(primary_reader & preader, int & index)
 {
   preader.read_value(index);
   FaceVector::size_type actual_face_index = (index < 0 ? -index-1 : index);
-  if (actual_face_index >= faces_.size())
+  if (actual_face_index >= temporaries_->faces_.size())
   {
     throw make_exception<parsing_error>( "face index out of bounds: " + boost::lexical_cast<std::string>(index)
                                        + " turns into actual face index of: " + boost::lexical_cast<std::string>(actual_face_index)
-                                       + " max: " + boost::lexical_cast<std::string>(faces_.size()-1)
+                                       + " max: " + boost::lexical_cast<std::string>(temporaries_->faces_.size()-1)
                                        );
   }
 }
@@ -352,27 +907,28 @@ grd_bnd_reader::VertexIndex grd_bnd_reader::get_oriented_edge_vertex(int edge_in
   if (edge_index < 0)
   {
     actual_edge_index = -edge_index-1; //so -1 -> 0, -2 -> 1 etc.
-    return edges_[actual_edge_index][1-vertex_index];
+    return temporaries_->edges_[actual_edge_index][1-vertex_index];
   }
   else
   {
     actual_edge_index = edge_index;
-    return edges_[actual_edge_index][vertex_index];
+    return temporaries_->edges_[actual_edge_index][vertex_index];
   }
 }
 
 grd_bnd_reader::VertexIndex grd_bnd_reader::get_oriented_face_vertex(int face_index, EdgeIndex edge_index, Edge::size_type vertex_index)
 {
+  FaceVector const & faces = temporaries_->faces_;
   FaceVector::size_type actual_face_index;
   if (face_index < 0)
   {
     actual_face_index = -face_index-1;
-    return get_oriented_edge_vertex(-faces_[actual_face_index][faces_[actual_face_index].size()-edge_index]-1, vertex_index);
+    return get_oriented_edge_vertex(-faces[actual_face_index][faces[actual_face_index].size()-edge_index]-1, vertex_index);
   }
   else
   {
     actual_face_index = face_index;
-    return get_oriented_edge_vertex(faces_[actual_face_index][edge_index], vertex_index);
+    return get_oriented_edge_vertex(faces[actual_face_index][edge_index], vertex_index);
   }
 }
 
@@ -0,0 +1,51 @@
+#include "viennautils/dfise/input_source.hpp"
+
+namespace viennautils
+{
+namespace dfise
+{
+
+input_source::input_source( source_type type
+                          , std::string const & name
+                          )
+                          : type_(type)
+                          , name_(name)
+                          , data_(0)
+                          , size_(0)
+                          , descriptor_(-1)
+                          , stream_(0)
+{
+}
+
+input_source input_source::file(std::string const & path, std::string const & index_path)
+{
+  input_source source(source_type_file, path);
+  source.index_path_ = index_path;
+  return source;
+}
+
+input_source input_source::memory(char const* data, std::size_t size, std::string const & name)
+{
+  input_source source(source_type_memory, name);
+  source.data_ = data;
+  source.size_ = size;
+  return source;
+}
+
+input_source input_source::descriptor(int descriptor, std::string const & name)
+{
+  input_source source(source_type_descriptor, name);
+  source.descriptor_ = descriptor;
+  return source;
+}
+
+input_source input_source::stream(std::istream & stream, std::string const & name)
+{
+  input_source source(source_type_stream, name);
+  source.stream_ = &stream;
+  return source;
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
@@ -0,0 +1,35 @@
+#include "viennautils/dfise/memory_usage.hpp"
+
+namespace viennautils
+{
+namespace dfise
+{
+
+std::size_t memory_usage::total_bytes() const
+{
+  std::size_t total = 0;
+  for (StructureVector::const_iterator it = structures_.begin(); it != structures_.end(); ++it)
+  {
+    total += it->second;
+  }
+  return total;
+}
+
+std::size_t heap_bytes(std::string const & s)
+{
+  return s.capacity();
+}
+
+std::size_t heap_bytes(std::vector<std::string> const & v)
+{
+  std::size_t bytes = heap_bytes<std::string>(v);
+  for (std::vector<std::string>::const_iterator it = v.begin(); it != v.end(); ++it)
+  {
+    bytes += heap_bytes(*it);
+  }
+  return bytes;
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
@@ -0,0 +1,261 @@
+#include "viennautils/dfise/number_parser.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+#if defined(_WIN32)
+  #include <locale.h>
+  #define VIENNAUTILS_DFISE_HAS_STRTOD_L
+#elif defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__)
+  #include <locale.h>
+  #ifdef __APPLE__
+    #include <xlocale.h>
+  #endif
+  #define VIENNAUTILS_DFISE_HAS_STRTOD_L
+#else
+  #include <locale>
+  #include <sstream>
+#endif
+
+namespace viennautils
+{
+namespace dfise
+{
+
+namespace
+{
+
+//all powers of ten that can be represented exactly as doubles
+double const exact_powers_of_ten[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9, 1e10, 1e11
+                                     , 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+                                     };
+int const max_exact_power_of_ten = 22;
+
+//2^53 - the largest mantissa for which every integer below it is exactly representable as double
+boost::uint64_t const max_exact_mantissa = boost::uint64_t(1) << 53;
+
+//the number of decimal digits that are guaranteed to fit into a 64 bit mantissa
+int const max_mantissa_digits = 19;
+
+#if defined(_WIN32)
+_locale_t const c_locale = _create_locale(LC_NUMERIC, "C");
+#elif defined(VIENNAUTILS_DFISE_HAS_STRTOD_L)
+locale_t const c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+#endif
+
+bool is_digit(char c)
+{
+  return static_cast<unsigned int>(c - '0') <= 9;
+}
+
+bool equals_ignoring_case(char const * begin, char const * end, char const * lowercase)
+{
+  for (; begin != end && *lowercase; ++begin, ++lowercase)
+  {
+    if (*begin != *lowercase && *begin != *lowercase - ('a' - 'A'))
+    {
+      return false;
+    }
+  }
+  return begin == end && !*lowercase;
+}
+
+bool parse_special_value(char const * begin, char const * end, bool negative, double & value)
+{
+  if (equals_ignoring_case(begin, end, "inf") || equals_ignoring_case(begin, end, "infinity"))
+  {
+    value = negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+    return true;
+  }
+  if (equals_ignoring_case(begin, end, "nan"))
+  {
+    value = negative ? -std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::quiet_NaN();
+    return true;
+  }
+  return false;
+}
+
+//slow, but correctly rounded fallback for all values that cannot be converted exactly in parse_number
+//the range has already been validated at this point
+bool parse_with_c_library(char const * begin, char const * end, double & value)
+{
+  char stack_buffer[128];
+  std::string heap_buffer;
+  char const * str = stack_buffer;
+  std::size_t length = end - begin;
+  if (length < sizeof(stack_buffer))
+  {
+    std::memcpy(stack_buffer, begin, length);
+    stack_buffer[length] = '\0';
+  }
+  else
+  {
+    heap_buffer.assign(begin, end);
+    str = heap_buffer.c_str();
+  }
+
+#ifdef VIENNAUTILS_DFISE_HAS_STRTOD_L
+  char * str_end;
+  errno = 0;
+#ifdef _WIN32
+  value = _strtod_l(str, &str_end, c_locale);
+#else
+  value = strtod_l(str, &str_end, c_locale);
+#endif
+  //underflow is fine (the result is the correctly rounded denormal or zero) - overflow is not
+  if (str_end != str + length || (errno == ERANGE && (value > 1.0 || value < -1.0)))
+  {
+    return false;
+  }
+  return true;
+#else
+  std::istringstream stream(str);
+  stream.imbue(std::locale::classic());
+  stream >> value;
+  return !stream.fail() && stream.peek() == std::char_traits<char>::eof();
+#endif
+}
+
+} //end of anonymous namespace
+
+bool parse_number(char const * begin, char const * end, double & value)
+{
+  char const * const original_begin = begin;
+
+  bool negative = false;
+  if (begin != end && (*begin == '-' || *begin == '+'))
+  {
+    negative = (*begin == '-');
+    ++begin;
+  }
+  char const * const digits_begin = begin;
+  
+  //the value is mantissa*10^exponent
+  //zeros are only multiplied into the mantissa once a non-zero digit follows them, so trailing zeros never exhaust
+  //the available mantissa digits
+  boost::uint64_t mantissa = 0;
+  int mantissa_digits = 0;
+  int exponent = 0;
+  int pending_zeros = 0;
+  int pending_fraction_zeros = 0;
+  bool truncated = false;
+  bool has_digits = false;
+  bool in_fraction = false;
+  
+  for (; begin != end; ++begin)
+  {
+    char c = *begin;
+    if (c == '.' && !in_fraction)
+    {
+      in_fraction = true;
+      continue;
+    }
+    if (!is_digit(c))
+    {
+      break;
+    }
+    has_digits = true;
+    
+    unsigned int digit = static_cast<unsigned int>(c - '0');
+    if (digit == 0)
+    {
+      if (mantissa_digits == 0)
+      {
+        //leading zero
+        exponent -= in_fraction ? 1 : 0;
+      }
+      else
+      {
+        ++pending_zeros;
+        pending_fraction_zeros += in_fraction ? 1 : 0;
+      }
+      continue;
+    }
+    
+    if (mantissa_digits + pending_zeros + 1 > max_mantissa_digits)
+    {
+      truncated = true;
+      continue;
+    }
+    for (; pending_zeros > 0; --pending_zeros)
+    {
+      mantissa *= 10;
+      ++mantissa_digits;
+    }
+    exponent -= pending_fraction_zeros + (in_fraction ? 1 : 0);
+    pending_fraction_zeros = 0;
+    
+    mantissa = mantissa*10 + digit;
+    ++mantissa_digits;
+  }
+  //zeros in front of the decimal point that were not multiplied into the mantissa still scale the value
+  exponent += pending_zeros - pending_fraction_zeros;
+  
+  if (!has_digits)
+  {
+    return parse_special_value(digits_begin, end, negative, value);
+  }
+  
+  if (begin != end)
+  {
+    if (*begin != 'e' && *begin != 'E')
+    {
+      return false;
+    }
+    ++begin;
+    
+    bool negative_exponent = false;
+    if (begin != end && (*begin == '-' || *begin == '+'))
+    {
+      negative_exponent = (*begin == '-');
+      ++begin;
+    }
+    if (begin == end)
+    {
+      return false;
+    }
+    
+    int explicit_exponent = 0;
+    for (; begin != end; ++begin)
+    {
+      if (!is_digit(*begin))
+      {
+        return false;
+      }
+      //clamping is fine, such values over- or underflow anyway
+      if (explicit_exponent < 100000)
+      {
+        explicit_exponent = explicit_exponent*10 + (*begin - '0');
+      }
+    }
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+  }
+  
+  if (mantissa == 0 && !truncated)
+  {
+    value = negative ? -0.0 : 0.0;
+    return true;
+  }
+  
+  //if both mantissa and power of ten are exact doubles, a single (correctly rounded) operation yields the result
+  if (!truncated && mantissa <= max_exact_mantissa)
+  {
+    if (exponent >= -max_exact_power_of_ten && exponent <= max_exact_power_of_ten)
+    {
+      double result = static_cast<double>(mantissa);
+      result = (exponent < 0) ? result / exact_powers_of_ten[-exponent] : result * exact_powers_of_ten[exponent];
+      value = negative ? -result : result;
+      return true;
+    }
+  }
+  
+  return parse_with_c_library(original_begin, end, value);
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
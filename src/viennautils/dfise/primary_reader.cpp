@@ -1,32 +1,480 @@
 #include "viennautils/dfise/primary_reader.hpp"
 
 #include <map>
+#include <vector>
+#include <new>
+#include <stdexcept>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
 
 namespace viennautils
 {
 namespace dfise
 {
 
+namespace
+{
+
+#ifdef _OPENMP
+
+//below this number of values the threads would hardly have anything to do
+std::size_t const parallel_values_threshold = 1 << 16;
+
+//converts the count values following the current position of tp if they make up the rest of the current block
+//  returns false (and leaves tp where it was) if anything is unusual (e.g. invalid values or a different number of them),
+//  the serial path then takes over and produces the appropriate error
+bool read_values_in_parallel(token_parser & tp, double * target, std::size_t count)
+{
+  std::size_t begin_offset = tp.tell();
+  try
+  {
+    tp.skip_block();
+  }
+  catch (parsing_error const &)
+  {
+    tp.seek(begin_offset);
+    return false;
+  }
+  char const* begin = tp.data() + begin_offset;
+  char const* end = tp.data() + tp.tell() - 1; //the closing }
+  tp.seek(begin_offset);
+  
+  //the chunks start at the beginning of a line, thus no value (or comment) is split between two chunks
+  std::size_t const chunk_count = 4*omp_get_max_threads();
+  std::vector<char const*> chunk_begins(1, begin);
+  for (std::size_t i = 1; i < chunk_count; ++i)
+  {
+    char const* split = begin + (end - begin)/chunk_count*i;
+    if (split < chunk_begins.back())
+    {
+      continue;
+    }
+    char const* line_end = static_cast<char const*>(std::memchr(split, '\n', end - split));
+    if (line_end == 0)
+    {
+      break;
+    }
+    chunk_begins.push_back(line_end + 1);
+  }
+  chunk_begins.push_back(end);
+  long const chunks = static_cast<long>(chunk_begins.size() - 1);
+  
+  //first pass: count the values per chunk to know where each chunk's values go
+  //  exceptions must not leave the parallel regions, hence the flag (e.g. for unterminated quotes)
+  bool valid = true;
+  std::vector<std::size_t> chunk_offsets(chunk_begins.size(), 0);
+  #pragma omp parallel for schedule(dynamic) reduction(&&:valid)
+  for (long i = 0; i < chunks; ++i)
+  {
+    try
+    {
+      token_parser chunk(chunk_begins[i], chunk_begins[i+1]);
+      std::size_t values = 0;
+      for (; chunk.has_next(); chunk.get_next())
+      {
+        ++values;
+      }
+      chunk_offsets[i+1] = values;
+    }
+    catch (parsing_error const &)
+    {
+      valid = false;
+    }
+  }
+  for (long i = 0; i < chunks; ++i)
+  {
+    chunk_offsets[i+1] += chunk_offsets[i];
+  }
+  if (!valid || chunk_offsets.back() != count)
+  {
+    return false;
+  }
+  
+  //second pass: the actual conversion (every token is known to be tokenizable by now)
+  #pragma omp parallel for schedule(dynamic) reduction(&&:valid)
+  for (long i = 0; i < chunks; ++i)
+  {
+    token_parser chunk(chunk_begins[i], chunk_begins[i+1]);
+    for (double * value = target + chunk_offsets[i]; chunk.has_next(); ++value)
+    {
+      token tok = chunk.get_next();
+      valid = parse_number(tok.begin(), tok.end(), *value) && valid;
+    }
+  }
+  if (!valid)
+  {
+    return false;
+  }
+  
+  tp.seek(end - tp.data());
+  return true;
+}
+
+#endif
+
+} //end of anonymous namespace
+
+primary_reader::primary_reader( std::string const & filename
+                              , ParsingFunc const & additional_info_parsing_func
+                              , ParsingFunc const & data_block_parsing_func
+                              , read_mode mode
+                              , access_mode access
+                              )
+                              : tp_(filename, (mode == read_mode_direct) ? access : access_mode_random)
+                              , pipeline_(0)
+                              , mode_(read_mode_direct)
+{
+  parse(additional_info_parsing_func, data_block_parsing_func, mode);
+}
+
 primary_reader::primary_reader( std::string const & filename
+                              , ParsingFunc const & additional_info_parsing_func
+                              , access_mode access
+                              )
+                              : tp_(filename, access)
+                              , pipeline_(0)
+                              , mode_(read_mode_direct)
+{
+  parse_header(additional_info_parsing_func);
+}
+
+primary_reader::primary_reader( input_source const & source
                               , ParsingFunc const & additional_info_parsing_func
                               , ParsingFunc const & data_block_parsing_func
+                              , read_mode mode
+                              , access_mode access
                               )
-                              : tp_(filename)
+                              : tp_(source, (mode == read_mode_direct) ? access : access_mode_random)
+                              , pipeline_(0)
+                              , mode_(read_mode_direct)
+{
+  //the pipeline tokenizes every block anyway
+  if (mode != read_mode_pipelined)
+  {
+    open_block_index(source);
+  }
+  parse(additional_info_parsing_func, data_block_parsing_func, mode);
+}
+
+primary_reader::primary_reader( input_source const & source
+                              , ParsingFunc const & additional_info_parsing_func
+                              , access_mode access
+                              )
+                              : tp_(source, access)
+                              , pipeline_(0)
+                              , mode_(read_mode_direct)
+{
+  open_block_index(source);
+  parse_header(additional_info_parsing_func);
+}
+
+primary_reader::primary_reader( primary_reader const & other
+                              , std::size_t offset
+                              )
+                              : mandatory_info_(other.mandatory_info_)
+                              , tp_(other.tp_.data(), other.tp_.data() + other.tp_.size())
+                              , pipeline_(0)
+                              , mode_(read_mode_direct)
+                              , index_(other.index_)
+{
+  tp_.seek(offset);
+}
+
+void primary_reader::open_block_index(input_source const & source)
+{
+  if (source.get_index_path().empty() || !tp_.random_access())
+  {
+    return;
+  }
+  
+  boost::shared_ptr<block_index> index(new block_index);
+  if (!index->load(source.get_index_path(), source.get_name()))
+  {
+    std::size_t const offset = tp_.tell();
+    try
+    {
+      index->build(tp_);
+    }
+    catch (parsing_error const &)
+    {
+      //the file is read without index then, parsing it reports the error properly
+      tp_.seek(offset);
+      return;
+    }
+    tp_.seek(offset);
+    
+    try
+    {
+      index->save(source.get_index_path(), source.get_name());
+    }
+    catch (parsing_error const &)
+    {
+      //the index is still used for this reader, it is just built once more next time
+    }
+  }
+  index_ = index;
+}
+
+void primary_reader::parse(ParsingFunc const & additional_info_parsing_func, ParsingFunc const & data_block_parsing_func, read_mode mode)
 {
-  //read header
-  tp_.expect("DF-ISE", "invalid/unsupported file header");
-  tp_.expect("text", "invalid/unsupported file header");
+  mode_ = mode;
+  parse_header(additional_info_parsing_func);
+  if (mode == read_mode_pipelined)
+  {
+    //the pipeline only lives during the construction, no member outlives it if an exception is thrown
+    token_pipeline pipeline(tp_);
+    pipeline_ = &pipeline;
+    pipeline.run(boost::bind(&primary_reader::parse_data, this, boost::cref(data_block_parsing_func)));
+    pipeline_ = 0;
+  }
+  else
+  {
+    parse_data(data_block_parsing_func);
+  }
+}
+
+void primary_reader::parse_header(ParsingFunc const & additional_info_parsing_func)
+{
+  expect("DF-ISE", "invalid/unsupported file header");
+  token format = next_token();
+  if (format == "binary")
+  {
+    throw make_exception<parsing_error>("binary DF-ISE not supported");
+  }
+  if (format != "text")
+  {
+    throw make_exception<parsing_error>("invalid/unsupported file header expected: text got: " + format.str());
+  }
   
   read_block("Info", boost::bind(&primary_reader::parse_info_block, this, additional_info_parsing_func));
+}
+
+void primary_reader::parse_data(ParsingFunc const & data_block_parsing_func)
+{
   read_block("Data", boost::bind(data_block_parsing_func, boost::ref(*this)));
 }
 
+void primary_reader::seek(std::size_t offset)
+{
+  if (pipeline_)
+  {
+    throw make_exception<parsing_error>("cannot seek while reading pipelined");
+  }
+  tp_.seek(offset);
+}
+
+void primary_reader::expect(std::string const & expected, std::string const & error_msg)
+{
+  if (pipeline_)
+  {
+    pipeline_->expect(expected, error_msg);
+  }
+  else
+  {
+    tp_.expect(expected, error_msg);
+  }
+}
+
+void primary_reader::read_value(double & target)
+{
+  if (!pipeline_)
+  {
+    target = convert_to<double>(tp_.get_next());
+    return;
+  }
+  token tok = pipeline_->get_next();
+  if (!pipeline_->get_number(target))
+  {
+    throw make_exception<parsing_error>("could not convert " + tok.str() + " to expected type");
+  }
+}
+
 void primary_reader::read_block(std::string const & name, boost::function<void ()> const & func)
 {
-  tp_.expect(name, "block has invalid name");
-  tp_.expect("{", "expected begin of block");
-  func();
-  tp_.expect("}", "expected end of block");
+  read_block_without_parameter(name, func);
+}
+
+void primary_reader::read_values(double * target, std::size_t count)
+{
+#ifdef _OPENMP
+  //the pipeline converts the values in advance anyway, within a parallel region (e.g. read_many) there are no threads to spare
+  //  the chunks are split within the content as a whole, which is only available with random access
+  if (  !pipeline_ && tp_.random_access() && count >= parallel_values_threshold && omp_get_max_threads() > 1 && !omp_in_parallel()
+     && read_values_in_parallel(tp_, target, count)
+     )
+  {
+    return;
+  }
+#endif
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    read_value(target[i]);
+  }
+}
+
+void primary_reader::skip_values(std::size_t count)
+{
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    next_token();
+  }
+}
+
+void primary_reader::skip_block(std::string const & name)
+{
+  if (index_ && !pipeline_)
+  {
+    token tok = tp_.get_next();
+    if (tok != name)
+    {
+      throw make_exception<parsing_error>("block has invalid name expected: " + name + " got: " + tok.str());
+    }
+    block_index::entry const * e = index_->find_at(tp_.offset_of(tok));
+    if (e != 0 && e->name_ == name)
+    {
+      tp_.seek(e->offset_ + e->length_);
+      return;
+    }
+  }
+  else
+  {
+    expect(name, "block has invalid name");
+  }
+  
+  token next = next_token();
+  if (next == "(")
+  {
+    next_token();
+    expect(")", "expected parameter to end");
+    next = next_token();
+  }
+  if (next != "{")
+  {
+    throw make_exception<parsing_error>("expected begin of block expected: { got: " + next.str());
+  }
+  //the pipeline has tokenized the block already, thus it is skipped token-wise
+  if (pipeline_)
+  {
+    pipeline_->skip_block();
+  }
+  else
+  {
+    tp_.skip_block();
+  }
+}
+
+bool primary_reader::skip_to_block_end()
+{
+  if (!index_ || pipeline_)
+  {
+    return false;
+  }
+  block_index::entry const * e = index_->find_enclosing(tp_.tell());
+  if (e == 0)
+  {
+    return false;
+  }
+  tp_.seek(e->offset_ + e->length_ - 1);
+  return true;
+}
+
+void primary_reader::read_blocks(std::string const & name, std::size_t count, BlockFunc const & func)
+{
+  if (mode_ != read_mode_parallel_blocks || pipeline_ || count < 2)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      func(*this, i);
+    }
+    return;
+  }
+  
+  //the pre-scan only matches braces, quotes and comments (see token_parser::skip_block)
+  std::size_t const start_offset = tell();
+  std::vector<std::size_t> offsets(count);
+  try
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      offsets[i] = tell();
+      skip_block(name);
+    }
+  }
+  catch (parsing_error const &)
+  {
+    //the blocks are parsed one after another then, so that the error is reported just like without pre-scan
+    seek(start_offset);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      func(*this, i);
+    }
+    return;
+  }
+  std::size_t const end_offset = tell();
+  
+  //exceptions must not leave the parallel region, the first error (in file order) is thrown afterwards
+  enum error_kind { no_error, parsing_failed, out_of_memory, other_error };
+  std::vector<std::string> errors(count);
+  std::vector<char> error_kinds(count, no_error);
+  long const block_count = static_cast<long>(count);
+  #pragma omp parallel
+  {
+    primary_reader reader(*this, offsets[0]);
+    #pragma omp for schedule(dynamic)
+    for (long i = 0; i < block_count; ++i)
+    {
+      try
+      {
+        reader.seek(offsets[i]);
+        func(reader, static_cast<std::size_t>(i));
+      }
+      catch (parsing_error const & e)
+      {
+        errors[i] = e.what();
+        error_kinds[i] = parsing_failed;
+      }
+      catch (std::bad_alloc const &)
+      {
+        error_kinds[i] = out_of_memory;
+      }
+      catch (std::exception const & e)
+      {
+        errors[i] = e.what();
+        error_kinds[i] = other_error;
+      }
+      catch (...)
+      {
+        error_kinds[i] = other_error;
+      }
+    }
+  }
+  
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    switch (error_kinds[i])
+    {
+      case no_error:
+      {
+        continue;
+      }
+      case parsing_failed:
+      {
+        throw make_exception<parsing_error>(errors[i]);
+      }
+      case out_of_memory:
+      {
+        throw std::bad_alloc();
+      }
+      case other_error:
+      {
+        //exceptions cannot be carried out of the parallel region in C++03, only their message is kept
+        throw std::runtime_error(errors[i].empty() ? "reading block " + name + " failed" : errors[i]);
+      }
+    }
+  }
+  seek(end_offset);
 }
 
 void primary_reader::parse_info_block(ParsingFunc const & additional_info_parsing_func)
@@ -0,0 +1,275 @@
+#include "viennautils/dfise/snapshot.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+
+#include "viennautils/filesystem/filesystem.hpp"
+#include "viennautils/dfise/grd_bnd_reader.hpp"
+#include "viennautils/dfise/parsing_error.hpp"
+
+namespace viennautils
+{
+namespace dfise
+{
+
+namespace
+{
+
+char const snapshot_magic[8] = {'D', 'F', 'I', 'S', 'E', 'S', 'N', 'P'};
+boost::uint32_t const snapshot_version = 2;
+boost::uint32_t const byte_order_mark = 0x01020304;
+
+struct snapshot_header
+{
+  char            magic_[8];
+  boost::uint32_t version_;
+  boost::uint32_t byte_order_;
+  boost::uint32_t kind_;
+  boost::uint32_t index_size_;
+  boost::uint64_t source_size_;
+  boost::int64_t  source_modification_time_;
+  boost::uint64_t payload_size_; //payload_size_ and checksum_ are filled in by snapshot_writer::commit
+  boost::uint64_t checksum_;
+};
+
+std::size_t const alignment = 8;
+
+std::size_t padded_size(std::size_t size)
+{
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+//FNV-1a style hash over 64 bit words, the payload always consists of whole words (every item is padded)
+boost::uint64_t const checksum_seed  = (static_cast<boost::uint64_t>(0xcbf29ce4) << 32) | 0x84222325;
+boost::uint64_t const checksum_prime = (static_cast<boost::uint64_t>(0x00000100) << 32) | 0x000001b3;
+
+boost::uint64_t update_checksum(boost::uint64_t checksum, char const * data, std::size_t size)
+{
+  for (std::size_t i = 0; i < size; i += sizeof(boost::uint64_t))
+  {
+    boost::uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    checksum = (checksum ^ word) * checksum_prime;
+  }
+  return checksum;
+}
+
+} //end of anonymous namespace
+
+std::string snapshot_path(std::string const & filename, std::string const & cache_directory)
+{
+  if (cache_directory.empty())
+  {
+    return filename + ".snapshot";
+  }
+
+  std::string mangled = filename;
+  for (std::string::iterator it = mangled.begin(); it != mangled.end(); ++it)
+  {
+    if (*it == '/' || *it == '\\' || *it == ':')
+    {
+      *it = '_';
+    }
+  }
+  char last = cache_directory[cache_directory.size()-1];
+  return cache_directory + ((last == '/' || last == '\\') ? "" : "/") + mangled + ".snapshot";
+}
+
+snapshot_writer::snapshot_writer(std::string const & snapshot_path, std::string const & filename, snapshot_kind kind)
+                                : snapshot_path_(snapshot_path)
+                                , temporary_path_(viennautils::filesystem::temporary_path(snapshot_path))
+                                , payload_size_(0)
+                                , checksum_(checksum_seed)
+                                , committed_(false)
+{
+  snapshot_header header;
+  std::memset(&header, 0, sizeof(header));
+  std::copy(snapshot_magic, snapshot_magic + sizeof(snapshot_magic), header.magic_);
+  header.version_ = snapshot_version;
+  header.byte_order_ = byte_order_mark;
+  header.kind_ = kind;
+  header.index_size_ = sizeof(index_type);
+  if (!viennautils::filesystem::get_file_status(filename, header.source_size_, header.source_modification_time_))
+  {
+    throw make_exception<parsing_error>("cannot access file " + filename);
+  }
+
+  stream_.open(temporary_path_.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  stream_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+  if (!stream_)
+  {
+    throw make_exception<parsing_error>("cannot write snapshot " + snapshot_path_);
+  }
+
+  //the snapshot is only valid for the very same path
+  write(filename);
+}
+
+snapshot_writer::~snapshot_writer()
+{
+  if (!committed_)
+  {
+    stream_.close();
+    std::remove(temporary_path_.c_str());
+  }
+}
+
+void snapshot_writer::write(boost::uint64_t value)
+{
+  write_bytes(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+void snapshot_writer::write(std::string const & value)
+{
+  write(static_cast<boost::uint64_t>(value.size()));
+  write_bytes(value.data(), value.size());
+}
+
+void snapshot_writer::write(std::vector<std::string> const & values)
+{
+  write(static_cast<boost::uint64_t>(values.size()));
+  for (std::vector<std::string>::const_iterator it = values.begin(); it != values.end(); ++it)
+  {
+    write(*it);
+  }
+}
+
+void snapshot_writer::write_bytes(char const * data, std::size_t size)
+{
+  std::size_t whole_words = size / alignment * alignment;
+  checksum_ = update_checksum(checksum_, data, whole_words);
+  stream_.write(data, whole_words);
+
+  if (whole_words != size)
+  {
+    char last_word[alignment] = {0};
+    std::copy(data + whole_words, data + size, last_word);
+    checksum_ = update_checksum(checksum_, last_word, alignment);
+    stream_.write(last_word, alignment);
+  }
+  payload_size_ += padded_size(size);
+}
+
+void snapshot_writer::commit()
+{
+  stream_.seekp(offsetof(snapshot_header, payload_size_));
+  stream_.write(reinterpret_cast<char const*>(&payload_size_), sizeof(payload_size_));
+  stream_.write(reinterpret_cast<char const*>(&checksum_), sizeof(checksum_));
+  stream_.close();
+  if (!stream_)
+  {
+    throw make_exception<parsing_error>("cannot write snapshot " + snapshot_path_);
+  }
+
+  //rename does not replace existing files on every platform
+  if (std::rename(temporary_path_.c_str(), snapshot_path_.c_str()) != 0)
+  {
+    std::remove(snapshot_path_.c_str());
+    if (std::rename(temporary_path_.c_str(), snapshot_path_.c_str()) != 0)
+    {
+      throw make_exception<parsing_error>("cannot write snapshot " + snapshot_path_);
+    }
+  }
+  committed_ = true;
+}
+
+bool snapshot_reader::open(std::string const & snapshot_path, std::string const & filename, snapshot_kind kind)
+{
+  file_.close();
+  position_ = end_ = 0;
+
+  boost::uint64_t source_size;
+  boost::int64_t source_modification_time;
+  if (  !viennautils::filesystem::get_file_status(filename, source_size, source_modification_time)
+     || !file_.open(snapshot_path)
+     || file_.size() < sizeof(snapshot_header)
+     )
+  {
+    return false;
+  }
+
+  snapshot_header header;
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (  !std::equal(snapshot_magic, snapshot_magic + sizeof(snapshot_magic), header.magic_)
+     || header.version_ != snapshot_version
+     || header.byte_order_ != byte_order_mark
+     || header.kind_ != static_cast<boost::uint32_t>(kind)
+     || header.index_size_ != sizeof(index_type)
+     || header.source_size_ != source_size
+     || header.source_modification_time_ != source_modification_time
+     || header.payload_size_ != file_.size() - sizeof(header)
+     || update_checksum(checksum_seed, file_.data() + sizeof(header), file_.size() - sizeof(header)) != header.checksum_
+     )
+  {
+    file_.close();
+    return false;
+  }
+
+  position_ = file_.data() + sizeof(header);
+  end_ = file_.data() + file_.size();
+
+  std::string snapshot_filename;
+  if (!read(snapshot_filename) || snapshot_filename != filename)
+  {
+    file_.close();
+    position_ = end_ = 0;
+    return false;
+  }
+  return true;
+}
+
+bool snapshot_reader::read(boost::uint64_t & value)
+{
+  if (static_cast<std::size_t>(end_ - position_) < sizeof(value))
+  {
+    return false;
+  }
+  std::memcpy(&value, position_, sizeof(value));
+  return skip(sizeof(value));
+}
+
+bool snapshot_reader::read(std::string & value)
+{
+  boost::uint64_t size;
+  if (!read(size) || size > static_cast<boost::uint64_t>(end_ - position_))
+  {
+    return false;
+  }
+  value.assign(position_, static_cast<std::size_t>(size));
+  return skip(value.size());
+}
+
+bool snapshot_reader::read(std::vector<std::string> & values)
+{
+  boost::uint64_t size;
+  //every string takes at least one word, which bounds the size of corrupt snapshots
+  if (!read(size) || size > static_cast<boost::uint64_t>(end_ - position_)/alignment)
+  {
+    return false;
+  }
+  values.resize(static_cast<std::size_t>(size));
+  for (std::vector<std::string>::iterator it = values.begin(); it != values.end(); ++it)
+  {
+    if (!read(*it))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool snapshot_reader::skip(std::size_t size)
+{
+  size = padded_size(size);
+  if (size > static_cast<std::size_t>(end_ - position_))
+  {
+    return false;
+  }
+  position_ += size;
+  return true;
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
@@ -1,128 +1,624 @@
 #include "viennautils/dfise/token_parser.hpp"
 
+#include <algorithm>
+
 #include "viennautils/dfise/parsing_error.hpp"
 
+#if !defined(VIENNAUTILS_DFISE_NO_SIMD)
+  #if defined(__AVX2__)
+    #include <immintrin.h>
+    #define VIENNAUTILS_DFISE_AVX2
+  #elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define VIENNAUTILS_DFISE_SSE2
+  #endif
+#endif
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
 namespace viennautils
 {
 namespace dfise
 {
 
+namespace
+{
+
+typedef boost::uint64_t Mask;
+
+unsigned int count_trailing_zeros(Mask mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return index;
+#elif defined(_MSC_VER)
+  unsigned long index;
+  if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+  {
+    return index;
+  }
+  _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+  return index + 32;
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+enum char_class
+{
+  char_class_whitespace = 1,
+  char_class_token_end  = 2,
+  char_class_block      = 4  //the chars skip_block looks at: braces, '"' and '#'
+};
+
+#if defined(VIENNAUTILS_DFISE_AVX2)
+
+//whitespace: ' ', '\t', '\n'
+//token end: whitespace, '#' and the standalone chars '=', '(', ')', '[', ']', '{', '}'
+//  '(' and ')' only differ in the lowest bit, '[' and '{' as well as ']' and '}' only in bit 5
+void classify(char const* data, Mask & whitespace, Mask & token_end)
+{
+  whitespace = 0;
+  token_end = 0;
+  for (int i = 0; i < 2; ++i)
+  {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + 32*i));
+    __m256i ws = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '))
+                                                 , _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))
+                                                 )
+                                , _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'))
+                                );
+    __m256i folded_brackets = _mm256_and_si256(chunk, _mm256_set1_epi8(static_cast<char>(0xDF)));
+    __m256i special = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('#'))
+                                                      , _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('='))
+                                                      )
+                                     , _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8(folded_brackets, _mm256_set1_epi8('['))
+                                                                       , _mm256_cmpeq_epi8(folded_brackets, _mm256_set1_epi8(']'))
+                                                                       )
+                                                      , _mm256_cmpeq_epi8(_mm256_and_si256(chunk, _mm256_set1_epi8(static_cast<char>(0xFE))), _mm256_set1_epi8('('))
+                                                      )
+                                     );
+    whitespace |= static_cast<Mask>(static_cast<boost::uint32_t>(_mm256_movemask_epi8(ws))) << (32*i);
+    token_end  |= static_cast<Mask>(static_cast<boost::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(ws, special)))) << (32*i);
+  }
+}
+
+#elif defined(VIENNAUTILS_DFISE_SSE2)
+
+//see AVX2 version above
+void classify(char const* data, Mask & whitespace, Mask & token_end)
+{
+  whitespace = 0;
+  token_end = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 16*i));
+    __m128i ws = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '))
+                                           , _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))
+                                           )
+                             , _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))
+                             );
+    __m128i folded_brackets = _mm_and_si128(chunk, _mm_set1_epi8(static_cast<char>(0xDF)));
+    __m128i special = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(chunk, _mm_set1_epi8('#'))
+                                                , _mm_cmpeq_epi8(chunk, _mm_set1_epi8('='))
+                                                )
+                                  , _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(folded_brackets, _mm_set1_epi8('['))
+                                                              , _mm_cmpeq_epi8(folded_brackets, _mm_set1_epi8(']'))
+                                                              )
+                                                , _mm_cmpeq_epi8(_mm_and_si128(chunk, _mm_set1_epi8(static_cast<char>(0xFE))), _mm_set1_epi8('('))
+                                                )
+                                  );
+    whitespace |= static_cast<Mask>(_mm_movemask_epi8(ws) & 0xFFFF) << (16*i);
+    token_end  |= static_cast<Mask>(_mm_movemask_epi8(_mm_or_si128(ws, special)) & 0xFFFF) << (16*i);
+  }
+}
+
+#endif
+
+struct char_class_table
+{
+  char_class_table()
+  {
+    for (int c = 0; c < 256; ++c)
+    {
+      char ch = static_cast<char>(c);
+      bool whitespace = (ch == ' ') || (ch == '\t') || (ch == '\n');
+      bool token_end = whitespace || (ch == '#') || (ch == '=') || (ch == '{') || (ch == '[') || (ch == '(')
+                                  || (ch == ')') || (ch == ']') || (ch == '}');
+      bool block = (ch == '{') || (ch == '}') || (ch == '\"') || (ch == '#');
+      classes[c] = (whitespace ? char_class_whitespace : 0) | (token_end ? char_class_token_end : 0) | (block ? char_class_block : 0);
+    }
+  }
+  
+  unsigned char classes[256];
+};
+
+char_class_table const table;
+
+//portable classification of an arbitrary number of bytes (at most 64)
+void classify(char const* data, std::size_t count, Mask & whitespace, Mask & token_end)
+{
+  whitespace = 0;
+  token_end = 0;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    unsigned char c = table.classes[static_cast<unsigned char>(data[i])];
+    whitespace |= static_cast<Mask>(c & char_class_whitespace) << i;
+    token_end  |= static_cast<Mask>((c & char_class_token_end) >> 1) << i;
+  }
+}
+
+//returns the first char in [pos, end) of char_class_block, end if there is none
+char const* find_block_char(char const* pos, char const* end)
+{
+#if defined(VIENNAUTILS_DFISE_AVX2)
+  for (; end - pos >= 32; pos += 32)
+  {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pos));
+    __m256i hits = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('{'))
+                                                   , _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('}'))
+                                                   )
+                                  , _mm256_or_si256( _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\"'))
+                                                   , _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('#'))
+                                                   )
+                                  );
+    Mask mask = static_cast<boost::uint32_t>(_mm256_movemask_epi8(hits));
+    if (mask != 0)
+    {
+      return pos + count_trailing_zeros(mask);
+    }
+  }
+#elif defined(VIENNAUTILS_DFISE_SSE2)
+  for (; end - pos >= 16; pos += 16)
+  {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pos));
+    __m128i hits = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(chunk, _mm_set1_epi8('{'))
+                                             , _mm_cmpeq_epi8(chunk, _mm_set1_epi8('}'))
+                                             )
+                               , _mm_or_si128( _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"'))
+                                             , _mm_cmpeq_epi8(chunk, _mm_set1_epi8('#'))
+                                             )
+                               );
+    Mask mask = _mm_movemask_epi8(hits) & 0xFFFF;
+    if (mask != 0)
+    {
+      return pos + count_trailing_zeros(mask);
+    }
+  }
+#endif
+  while (pos != end && !(table.classes[static_cast<unsigned char>(*pos)] & char_class_block))
+  {
+    ++pos;
+  }
+  return pos;
+}
+
+//initial size of the window through which compressed content is read sequentially, it only grows for longer lines
+std::size_t const sequential_window_size = 1 << 20;
+
+//reads the rest of the stream in large chunks directly into buffer
+bool read_stream(std::istream & stream, std::vector<char> & buffer)
+{
+  std::size_t const chunk_size = 1 << 20;
+  std::size_t size = 0;
+  while (stream)
+  {
+    if (buffer.size() - size < chunk_size)
+    {
+      buffer.resize(std::max(2*buffer.size(), size + chunk_size));
+    }
+    stream.read(&buffer[size], chunk_size);
+    size += static_cast<std::size_t>(stream.gcount());
+  }
+  buffer.resize(size);
+  return stream.eof() && !stream.bad();
+}
+
+} //end of anonymous namespace
+
 token_parser::token_parser( std::string const & filename
+                          , access_mode access
+                          )
+                          : begin_(0)
+                          , current_(0)
+                          , end_(0)
+                          , content_end_(0)
+                          , offset_(0)
+                          , window_(0)
+                          , whitespace_mask_(0)
+                          , token_end_mask_(0)
+{
+  open(input_source::file(filename), access);
+}
+
+token_parser::token_parser( input_source const & source
+                          , access_mode access
                           )
-                          : file_(filename.c_str())
-                          , normalized_line_()
-                          , current_(normalized_line_.begin())
+                          : begin_(0)
+                          , current_(0)
+                          , end_(0)
+                          , content_end_(0)
+                          , offset_(0)
+                          , window_(0)
+                          , whitespace_mask_(0)
+                          , token_end_mask_(0)
 {
-  if (!file_)
+  open(source, access);
+}
+
+token_parser::token_parser( char const* begin
+                          , char const* end
+                          )
+                          : begin_(begin)
+                          , current_(begin)
+                          , end_(end)
+                          , content_end_(end)
+                          , offset_(0)
+                          , window_(0)
+                          , whitespace_mask_(0)
+                          , token_end_mask_(0)
+{
+  load_window(current_);
+}
+
+void token_parser::open(input_source const & source, access_mode access)
+{
+  switch (source.get_type())
+  {
+    case input_source::source_type_file:
+    {
+      if (!file_.open(source.get_name()))
+      {
+        throw make_exception<parsing_error>("cannot open file " + source.get_name());
+      }
+      begin_ = file_.data();
+      end_ = file_.data() + file_.size();
+      break;
+    }
+    case input_source::source_type_memory:
+    {
+      begin_ = source.get_data();
+      end_ = source.get_data() + source.get_size();
+      break;
+    }
+    case input_source::source_type_descriptor:
+    {
+      if (!file_.open(source.get_descriptor()))
+      {
+        throw make_exception<parsing_error>("cannot read from " + source.get_name());
+      }
+      begin_ = file_.data();
+      end_ = file_.data() + file_.size();
+      break;
+    }
+    case input_source::source_type_stream:
+    {
+      if (!read_stream(*source.get_stream(), buffer_))
+      {
+        throw make_exception<parsing_error>("cannot read from " + source.get_name());
+      }
+      begin_ = (buffer_.empty() ? 0 : &buffer_[0]);
+      end_ = begin_ + buffer_.size();
+      break;
+    }
+  }
+
+  compression method = detect_compression(begin_, end_ - begin_);
+  if (method != compression_none)
+  {
+    try
+    {
+      if (access == access_mode_sequential)
+      {
+        //the compressed content has to stay alive, files stay mapped and the content of streams is kept in compressed_
+        compressed_.swap(buffer_);
+        decompressor_.reset(new decompressor(method, begin_, end_ - begin_));
+        buffer_.resize(sequential_window_size);
+        begin_ = current_ = end_ = content_end_ = &buffer_[0];
+        refill();
+        return;
+      }
+      std::vector<char> decompressed;
+      decompress(method, begin_, end_ - begin_, decompressed);
+      file_.close();
+      buffer_.swap(decompressed);
+      begin_ = (buffer_.empty() ? 0 : &buffer_[0]);
+      end_ = begin_ + buffer_.size();
+    }
+    catch (parsing_error const & e)
+    {
+      throw make_exception<parsing_error>("cannot decompress " + source.get_name() + ": " + e.what());
+    }
+  }
+  current_ = begin_;
+  content_end_ = end_;
+  load_window(current_);
+}
+
+bool token_parser::refill()
+{
+  if (!decompressor_)
+  {
+    return false;
+  }
+  std::size_t const previous_window = end_ - current_;
+  std::size_t used = content_end_ - current_;
+  offset_ += current_ - begin_;
+  std::copy(current_, content_end_, buffer_.begin());
+  
+  //the window ends after the last line break of the content (or at its end), the buffer only grows if a single line
+  //does not fit into it
+  std::size_t window_end = 0;
+  while (window_end == 0)
   {
-    throw make_exception<parsing_error>("cannot open file " +  filename);
+    if (used == buffer_.size())
+    {
+      buffer_.resize(2*buffer_.size());
+    }
+    std::size_t const previous_used = used;
+    used += decompressor_->read(&buffer_[used], buffer_.size() - used);
+    if (decompressor_->finished())
+    {
+      window_end = used;
+      break;
+    }
+    for (std::size_t i = used; i > previous_used && window_end == 0; --i)
+    {
+      if (buffer_[i-1] == '\n')
+      {
+        window_end = i;
+      }
+    }
   }
+  
+  begin_ = current_ = &buffer_[0];
+  end_ = begin_ + window_end;
+  content_end_ = begin_ + used;
+  load_window(current_);
+  return window_end > previous_window;
 }
 
 bool token_parser::at_end() const
 {
-  return !file_.good();
+  return current_ == end_ && end_ == content_end_ && (!decompressor_ || decompressor_->finished());
 }
 
-std::string const & token_parser::get_next()
+bool token_parser::has_next()
 {
-  while (current_ == normalized_line_.end())
+  for (;;)
   {
-    if (at_end())
+    current_ = skip_whitespace(current_);
+    
+    if (current_ == end_)
     {
-      throw make_exception<parsing_error>("unexpectedly reached end of file");
+      //sequential access: continue with the next window (if any)
+      if (refill())
+      {
+        continue;
+      }
+      return false;
     }
     
-    normalized_line_.clear();
-    
-    std::string line;
-    std::getline(file_, line);
-    
-    std::string::size_type start = 0;
-    //skip first whitespaces
-    while (start != line.size() && is_whitespace(line[start]))
+    if (!is_comment_token(*current_))
     {
-      ++start;
+      return true;
     }
     
-    while (start < line.size())
+    //a comment ranges until the end of the line
+    char const* line_end = static_cast<char const*>(std::memchr(current_, '\n', end_ - current_));
+    current_ = (line_end == 0) ? end_ : line_end;
+  }
+}
+
+token token_parser::get_next()
+{
+  if (!has_next())
+  {
+    throw make_exception<parsing_error>("unexpectedly reached end of file");
+  }
+  
+  char const* start = current_;
+  if (is_standalone(*start))
+  {
+    ++current_;
+  }
+  else if (is_string_separator(*start))
+  {
+    //reading a quoted string (which may span multiple lines)
+    for (++current_;; ++current_)
     {
-      if (is_comment_token(line[start]))
+      if (current_ == end_)
+      {
+        //sequential access: the string continues in the next window, which has to start with the token then
+        std::size_t const length = current_ - start;
+        current_ = start;
+        if (!refill())
+        {
+          throw make_exception<parsing_error>("unexpectedly reached end of file");
+        }
+        start = current_;
+        current_ = start + length;
+      }
+      if (is_string_separator(*current_))
       {
+        ++current_;
         break;
       }
-      else if(is_standalone(line[start]))
+      if (is_backslash(*current_) && current_+1 != end_)
+      {
+        //ignore next char
+        ++current_;
+      }
+    }
+  }
+  else
+  {
+    //reading anything but a quoted string
+    current_ = find_token_end(current_+1);
+  }
+  
+  return token(start, current_);
+}
+
+void token_parser::expect(std::string const & expected, std::string const & error_msg)
+{
+  token next = get_next();
+  if(next != expected)
+  {
+    throw make_exception<parsing_error>(error_msg + " expected: " + expected + " got: " + next.str());
+  }
+}
+
+void token_parser::skip_block()
+{
+  //only braces, quotes and comments matter, the chars in between are jumped over
+  //quotes only start a string at the beginning of a token (just like in get_next), i.e. at the beginning of the block,
+  //after a whitespace or a standalone char and right after a string
+  //with sequential access the scan continues in the next window, which follows a line break and thus starts a token
+  char const* token_start = current_;
+  unsigned int depth = 1;
+  char const* pos = current_;
+  for (;;)
+  {
+    pos = find_block_char(pos, end_);
+    if (pos == end_)
+    {
+      current_ = end_;
+      if (!refill())
       {
-        normalized_line_.push_back(line.substr(start,1));
-        ++start;
+        break;
       }
-      else 
+      pos = token_start = current_;
+      continue;
+    }
+    char c = *pos;
+    if (is_comment_token(c))
+    {
+      pos = static_cast<char const*>(std::memchr(pos, '\n', end_ - pos));
+      if (pos == 0)
       {
-        //reading more than a single char
-        std::string::size_type end = start+1;
-        
-        if (is_string_separator(line[start]))
+        break;
+      }
+    }
+    else if (is_string_separator(c))
+    {
+      if (pos == token_start || is_whitespace(pos[-1]) || is_standalone(pos[-1]))
+      {
+        for (++pos;; ++pos)
         {
-          //reading a quoted string
-          std::string multi_line;
-          for (;; ++end)
+          if (pos == end_)
           {
-            while(end >= line.size())
-            {
-              multi_line += line.substr(start) + "\n";
-              
-              if (at_end())
-              {
-                throw make_exception<parsing_error>("unexpectedly reached end of file");
-              }
-              std::getline(file_, line);
-              start = 0;
-              end = 0;
-            }
-            
-            if(is_string_separator(line[end]))
-            {
-              ++end;
-              normalized_line_.push_back(multi_line + line.substr(start, end-start));
-              break;
-            }
-            
-            if(is_backslash(line[end]))
+            current_ = end_;
+            if (!refill())
             {
-              //ignore next char
-              ++end;
+              throw make_exception<parsing_error>("unexpectedly reached end of file");
             }
+            pos = current_;
           }
-        }
-        else
-        {
-          //reading anything but a quoted string
-          while (end < line.size() && !is_comment_token(line[end]) && !is_whitespace(line[end]) && !is_standalone(line[end]))
+          if (is_string_separator(*pos))
+          {
+            break;
+          }
+          if (is_backslash(*pos) && pos+1 != end_)
           {
-            ++end;
+            ++pos;
           }
-          normalized_line_.push_back(line.substr(start, end-start));
         }
-        
-        start = end;
-      }
-      while (start != line.size() && is_whitespace(line[start]))
-      {
-        ++start;
+        token_start = pos+1;
       }
     }
-    current_ = normalized_line_.begin();
+    else if (c == '{')
+    {
+      ++depth;
+    }
+    else if (--depth == 0)
+    {
+      current_ = pos+1;
+      return;
+    }
+    ++pos;
   }
-  
-  return *(current_++);
+  throw make_exception<parsing_error>("unexpectedly reached end of file");
 }
 
-void token_parser::expect(std::string const & expected, std::string const & error_msg)
+void token_parser::seek(std::size_t offset)
 {
-  std::string const & next = get_next();
-  if(next != expected)
+  if (decompressor_)
   {
-    throw make_exception<parsing_error>(error_msg + " expected: " + expected + " got: " + next);
+    throw make_exception<parsing_error>("cannot seek within compressed content that is read sequentially");
+  }
+  if (offset > size())
+  {
+    throw make_exception<parsing_error>("cannot seek beyond the end of file");
+  }
+  current_ = begin_ + offset;
+  load_window(current_);
+}
+
+void token_parser::load_window(char const* window)
+{
+  window_ = window;
+  std::size_t remaining = end_ - window;
+#if defined(VIENNAUTILS_DFISE_AVX2) || defined(VIENNAUTILS_DFISE_SSE2)
+  if (remaining >= window_size)
+  {
+    classify(window, whitespace_mask_, token_end_mask_);
+    return;
+  }
+#endif
+  std::size_t count = (remaining < window_size) ? remaining : window_size;
+  classify(window, count, whitespace_mask_, token_end_mask_);
+  if (count < window_size)
+  {
+    Mask past_end = ~Mask(0) << count;
+    whitespace_mask_ |= past_end;
+    token_end_mask_ |= past_end;
+  }
+}
+
+char const* token_parser::skip_whitespace(char const* pos)
+{
+  for (;;)
+  {
+    if (pos >= end_)
+    {
+      return end_;
+    }
+    if (static_cast<std::size_t>(pos - window_) >= window_size)
+    {
+      load_window(pos);
+    }
+    Mask candidates = ~whitespace_mask_ & (~Mask(0) << (pos - window_));
+    if (candidates)
+    {
+      return window_ + count_trailing_zeros(candidates);
+    }
+    pos = window_ + window_size;
+  }
+}
+
+char const* token_parser::find_token_end(char const* pos)
+{
+  for (;;)
+  {
+    if (pos >= end_)
+    {
+      return end_;
+    }
+    if (static_cast<std::size_t>(pos - window_) >= window_size)
+    {
+      load_window(pos);
+    }
+    Mask candidates = token_end_mask_ & (~Mask(0) << (pos - window_));
+    if (candidates)
+    {
+      char const* token_end = window_ + count_trailing_zeros(candidates);
+      return (token_end < end_) ? token_end : end_;
+    }
+    pos = window_ + window_size;
   }
 }
 
@@ -0,0 +1,386 @@
+#include "viennautils/dfise/token_pipeline.hpp"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+#include "viennautils/dfise/number_parser.hpp"
+#include "viennautils/dfise/parsing_error.hpp"
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#ifdef _WIN32
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <sched.h>
+#endif
+
+namespace viennautils
+{
+namespace dfise
+{
+
+namespace
+{
+
+//how far the prefetching stage may run ahead of the tokenizer
+std::size_t const prefetch_distance = 64 << 20;
+std::size_t const page_size = 4096;
+
+//the counters shared between the stages are read and written atomically, the flushes around them make the batches
+//written before a store visible to the stage that loads the new value
+template <typename T>
+T load(T & shared)
+{
+  T value;
+  #pragma omp flush
+  #pragma omp atomic read
+  value = shared;
+  #pragma omp flush
+  return value;
+}
+
+template <typename T>
+void store(T & shared, T value)
+{
+  #pragma omp flush
+  #pragma omp atomic write
+  shared = value;
+  #pragma omp flush
+}
+
+//waiting stages spin for a short while and then give up their time slice
+void wait(unsigned int & spins)
+{
+  if (++spins < 128)
+  {
+    return;
+  }
+#ifdef _WIN32
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+} //end of anonymous namespace
+
+token_pipeline::token_pipeline( token_parser & tp
+                              )
+                              : tp_(tp)
+                              , begin_offset_(tp.tell())
+                              , ring_(ring_size)
+                              , tokenized_(0)
+                              , converted_(0)
+                              , consumed_(0)
+                              , tokenizer_offset_(tp.tell())
+                              , stop_(false)
+                              , prefetched_(0)
+                              , inline_(true)
+                              , current_(0)
+                              , batch_number_(0)
+                              , index_(0)
+{
+}
+
+void token_pipeline::run(boost::function<void ()> const & func)
+{
+  enum error_kind { no_error, parsing_failed, out_of_memory, other_error };
+  error_kind failed = no_error;
+  std::string error;
+
+#ifdef _OPENMP
+  //one thread per stage (consumer, tokenizer, converter and prefetcher) as far as available, but at least one besides
+  //the consumer - the stages hardly do anything else than waiting for each other otherwise
+  int const stage_threads = std::min(4, std::max(2, omp_get_max_threads()));
+#endif
+  #pragma omp parallel num_threads(stage_threads)
+  {
+    int thread = 0;
+    int threads = 1;
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+    threads = omp_get_num_threads();
+#endif
+    if (thread == 0)
+    {
+      inline_ = (threads < 2);
+      try
+      {
+        func();
+      }
+      catch (parsing_error const & e)
+      {
+        failed = parsing_failed;
+        error = e.what();
+      }
+      catch (std::bad_alloc const &)
+      {
+        failed = out_of_memory;
+      }
+      catch (std::exception const & e)
+      {
+        failed = other_error;
+        error = e.what();
+      }
+      catch (...)
+      {
+        failed = other_error;
+        error = "unknown error while reading pipelined";
+      }
+      //the other stages might still be waiting for free batches
+      store(stop_, true);
+    }
+    else if (thread == 1)
+    {
+      tokenize_stage(threads < 3);
+    }
+    else if (thread == 2)
+    {
+      convert_stage();
+    }
+    else if (thread == 3)
+    {
+      prefetch_stage();
+    }
+  }
+
+  switch (failed)
+  {
+    case no_error:
+    {
+      break;
+    }
+    case parsing_failed:
+    {
+      throw make_exception<parsing_error>(error);
+    }
+    case out_of_memory:
+    {
+      throw std::bad_alloc();
+    }
+    case other_error:
+    {
+      throw std::runtime_error(error);
+    }
+  }
+}
+
+token token_pipeline::get_next()
+{
+  while (current_ == 0 || index_ == current_->count_)
+  {
+    if (current_ != 0 && current_->last_)
+    {
+      throw make_exception<parsing_error>(current_->error_.empty() ? "unexpectedly reached end of file" : current_->error_);
+    }
+    next_batch();
+  }
+  return current_->tokens_[index_++];
+}
+
+void token_pipeline::expect(std::string const & expected, std::string const & error_msg)
+{
+  token next = get_next();
+  if(next != expected)
+  {
+    throw make_exception<parsing_error>(error_msg + " expected: " + expected + " got: " + next.str());
+  }
+}
+
+void token_pipeline::skip_block()
+{
+  //quoted strings and comments have already been dealt with by the tokenizer
+  unsigned int depth = 1;
+  for (;;)
+  {
+    token tok = get_next();
+    if (tok == "{")
+    {
+      ++depth;
+    }
+    else if (tok == "}" && --depth == 0)
+    {
+      return;
+    }
+  }
+}
+
+std::size_t token_pipeline::tell() const
+{
+  if (current_ == 0)
+  {
+    return begin_offset_;
+  }
+  return current_->tokens_[index_-1].end() - tp_.data();
+}
+
+void token_pipeline::tokenize_stage(bool convert)
+{
+  unsigned int spins = 0;
+  std::size_t tokenized = load(tokenized_);
+  for (;;)
+  {
+    if (load(stop_))
+    {
+      return;
+    }
+    if (tokenized - load(consumed_) == ring_size)
+    {
+      wait(spins);
+      continue;
+    }
+    spins = 0;
+
+    batch & b = ring_[tokenized % ring_size];
+    tokenize_batch(b);
+    if (convert)
+    {
+      convert_batch(b);
+    }
+
+    ++tokenized;
+    store(tokenizer_offset_, tp_.tell());
+    store(tokenized_, tokenized);
+    if (convert)
+    {
+      store(converted_, tokenized);
+    }
+
+    if (b.last_)
+    {
+      return;
+    }
+  }
+}
+
+void token_pipeline::convert_stage()
+{
+  unsigned int spins = 0;
+  std::size_t converted = load(converted_);
+  for (;;)
+  {
+    if (load(stop_))
+    {
+      return;
+    }
+    if (converted == load(tokenized_))
+    {
+      wait(spins);
+      continue;
+    }
+    spins = 0;
+
+    batch & b = ring_[converted % ring_size];
+    convert_batch(b);
+
+    ++converted;
+    store(converted_, converted);
+
+    if (b.last_)
+    {
+      return;
+    }
+  }
+}
+
+void token_pipeline::prefetch_stage()
+{
+  char const* data = tp_.data();
+  std::size_t size = tp_.size();
+  std::size_t offset = begin_offset_ / page_size * page_size;
+
+  //reading one byte per page is enough to have the page read from disk
+  unsigned char sum = 0;
+  unsigned int spins = 0;
+  while (offset < size)
+  {
+    if (load(stop_))
+    {
+      break;
+    }
+    if (offset > load(tokenizer_offset_) + prefetch_distance)
+    {
+      wait(spins);
+      continue;
+    }
+    spins = 0;
+    sum += static_cast<unsigned char>(data[offset]);
+    offset += page_size;
+  }
+  prefetched_ = sum;
+}
+
+void token_pipeline::tokenize_batch(batch & b)
+{
+  b.count_ = 0;
+  b.last_ = false;
+  try
+  {
+    while (b.count_ < batch_size)
+    {
+      if (!tp_.has_next())
+      {
+        b.last_ = true;
+        return;
+      }
+      b.tokens_[b.count_++] = tp_.get_next();
+    }
+  }
+  catch (parsing_error const & e)
+  {
+    b.last_ = true;
+    b.error_ = e.what();
+  }
+}
+
+void token_pipeline::convert_batch(batch & b)
+{
+  for (std::size_t i = 0; i < b.count_; ++i)
+  {
+    b.is_number_[i] = parse_number(b.tokens_[i].begin(), b.tokens_[i].end(), b.numbers_[i]);
+  }
+}
+
+void token_pipeline::next_batch()
+{
+  if (current_ != 0)
+  {
+    //the previous batch can be reused by the tokenizer
+    ++batch_number_;
+    store(consumed_, batch_number_);
+  }
+
+  if (inline_)
+  {
+    batch & b = ring_[batch_number_ % ring_size];
+    tokenize_batch(b);
+    convert_batch(b);
+    store(tokenizer_offset_, tp_.tell());
+    store(tokenized_, batch_number_ + 1);
+    store(converted_, batch_number_ + 1);
+  }
+  else
+  {
+    unsigned int spins = 0;
+    while (load(converted_) <= batch_number_)
+    {
+      wait(spins);
+    }
+  }
+
+  current_ = &ring_[batch_number_ % ring_size];
+  index_ = 0;
+}
+
+} //end of namespace dfise
+
+} //end of namespace viennautils
@@ -1,5 +1,24 @@
 #include "viennautils/filesystem/filesystem.hpp"
 
+#include <sstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+  #include <process.h>
+#else
+  #include <dirent.h>
+  #include <unistd.h>
+#endif
+
 namespace viennautils
 {
 namespace filesystem
@@ -52,5 +71,134 @@ std::string extract_path(std::string const & path, bool include_last_delimiter)
   return (last_path_delim == std::string::npos) ? "" : path.substr(0, last_path_delim + (include_last_delimiter ? 1 : 0));
 }
 
+bool get_file_status(std::string const & path, boost::uint64_t & size, boost::int64_t & modification_time)
+{
+#ifdef _WIN32
+  //_stat64 only has a resolution of seconds
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+  {
+    return false;
+  }
+  size = (static_cast<boost::uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+  //100 ns intervals since 1601-01-01
+  boost::uint64_t ticks = (static_cast<boost::uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+  boost::int64_t const epoch_ticks = static_cast<boost::int64_t>(11644473600) * 10000000;
+  modification_time = (static_cast<boost::int64_t>(ticks) - epoch_ticks) * 100;
+#else
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0)
+  {
+    return false;
+  }
+  size = static_cast<boost::uint64_t>(status.st_size);
+  #ifdef __APPLE__
+  long nanoseconds = status.st_mtimespec.tv_nsec;
+  #else
+  long nanoseconds = status.st_mtim.tv_nsec;
+  #endif
+  modification_time = static_cast<boost::int64_t>(status.st_mtime) * 1000000000 + nanoseconds;
+#endif
+  return true;
+}
+
+std::string temporary_path(std::string const & path)
+{
+  static unsigned long count = 0;
+  unsigned long number;
+  #pragma omp critical (viennautils_filesystem_temporary_path)
+  number = ++count;
+  
+#ifdef _WIN32
+  int process_id = _getpid();
+#else
+  long process_id = static_cast<long>(getpid());
+#endif
+  std::ostringstream result;
+  result << path << '.' << process_id << '.' << number << ".tmp";
+  return result.str();
+}
+
+bool list_files_recursively(std::string const & directory, std::vector<std::string> & files)
+{
+  std::vector<std::string> pending(1, directory);
+  for (bool top_level = true; !pending.empty(); top_level = false)
+  {
+    std::string path = pending.back();
+    pending.pop_back();
+    if (!path.empty() && path_delimiters.find(path[path.size()-1]) == std::string::npos)
+    {
+      path += '/';
+    }
+    
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE handle = FindFirstFileA((path + "*").c_str(), &entry);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+      if (top_level)
+      {
+        return false;
+      }
+      continue;
+    }
+    do
+    {
+      std::string name = entry.cFileName;
+      if (name == "." || name == "..")
+      {
+        continue;
+      }
+      if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+        {
+          pending.push_back(path + name);
+        }
+      }
+      else
+      {
+        files.push_back(path + name);
+      }
+    } while (FindNextFileA(handle, &entry));
+    FindClose(handle);
+#else
+    DIR * dir = opendir(path.c_str());
+    if (dir == 0)
+    {
+      if (top_level)
+      {
+        return false;
+      }
+      continue;
+    }
+    while (dirent * entry = readdir(dir))
+    {
+      std::string name = entry->d_name;
+      if (name == "." || name == "..")
+      {
+        continue;
+      }
+      std::string child = path + name;
+      struct stat status;
+      if (lstat(child.c_str(), &status) != 0)
+      {
+        continue;
+      }
+      if (S_ISDIR(status.st_mode))
+      {
+        pending.push_back(child);
+      }
+      else if (S_ISREG(status.st_mode) || (S_ISLNK(status.st_mode) && stat(child.c_str(), &status) == 0 && S_ISREG(status.st_mode)))
+      {
+        files.push_back(child);
+      }
+    }
+    closedir(dir);
+#endif
+  }
+  return true;
+}
+
 } //end of namespace filesystem
 } //end of namespace viennautils
@@ -0,0 +1,276 @@
+#include "viennautils/filesystem/mapped_file.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <cerrno>
+
+#ifdef _WIN32
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <windows.h>
+  #include <io.h>
+  #undef min
+  #undef max
+#else
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+namespace viennautils
+{
+namespace filesystem
+{
+
+namespace
+{
+
+//reads from descriptors go directly into the buffer in chunks of this size
+std::size_t const read_chunk_size = 1 << 20;
+
+} //end of anonymous namespace
+
+mapped_file::mapped_file() : is_open_(false), data_(0), size_(0), mapping_(0)
+#ifdef _WIN32
+                           , file_handle_(INVALID_HANDLE_VALUE), mapping_handle_(0)
+#endif
+{
+}
+
+mapped_file::mapped_file(std::string const & path) : is_open_(false), data_(0), size_(0), mapping_(0)
+#ifdef _WIN32
+                                                   , file_handle_(INVALID_HANDLE_VALUE), mapping_handle_(0)
+#endif
+{
+  open(path);
+}
+
+mapped_file::~mapped_file()
+{
+  close();
+}
+
+#ifdef _WIN32
+
+bool mapped_file::open(std::string const & path)
+{
+  close();
+
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &file_size))
+  {
+    CloseHandle(file);
+    return read_into_buffer(path);
+  }
+
+  if (file_size.QuadPart == 0)
+  {
+    //empty files cannot be mapped, but they are valid nonetheless
+    CloseHandle(file);
+    is_open_ = true;
+    return true;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  void* view = (mapping == NULL) ? NULL : MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == NULL)
+  {
+    if (mapping != NULL)
+    {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return read_into_buffer(path);
+  }
+
+  file_handle_ = file;
+  mapping_handle_ = mapping;
+  mapping_ = view;
+  data_ = static_cast<char const*>(view);
+  size_ = static_cast<std::size_t>(file_size.QuadPart);
+  is_open_ = true;
+  return true;
+}
+
+bool mapped_file::open(int descriptor)
+{
+  close();
+  return read_into_buffer(descriptor);
+}
+
+void mapped_file::close()
+{
+  if (mapping_)
+  {
+    UnmapViewOfFile(mapping_);
+    CloseHandle(mapping_handle_);
+    CloseHandle(file_handle_);
+    mapping_ = 0;
+    mapping_handle_ = 0;
+    file_handle_ = INVALID_HANDLE_VALUE;
+  }
+  std::vector<char>().swap(buffer_);
+  data_ = 0;
+  size_ = 0;
+  is_open_ = false;
+}
+
+#else
+
+bool mapped_file::open(std::string const & path)
+{
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode))
+  {
+    ::close(fd);
+    return read_into_buffer(path);
+  }
+
+  if (status.st_size == 0)
+  {
+    //empty files cannot be mapped, but they are valid nonetheless
+    ::close(fd);
+    is_open_ = true;
+    return true;
+  }
+
+  //the mapping stays valid after the descriptor is closed
+  bool mapped = map(fd, static_cast<std::size_t>(status.st_size));
+  ::close(fd);
+  return mapped || read_into_buffer(path);
+}
+
+bool mapped_file::open(int descriptor)
+{
+  close();
+
+  struct stat status;
+  if (fstat(descriptor, &status) != 0)
+  {
+    return false;
+  }
+
+  if (S_ISREG(status.st_mode))
+  {
+    if (status.st_size == 0)
+    {
+      is_open_ = true;
+      return true;
+    }
+    if (map(descriptor, static_cast<std::size_t>(status.st_size)))
+    {
+      return true;
+    }
+  }
+  return read_into_buffer(descriptor);
+}
+
+bool mapped_file::map(int descriptor, std::size_t size)
+{
+  void* mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  if (mapping == MAP_FAILED)
+  {
+    return false;
+  }
+#ifdef MADV_SEQUENTIAL
+  madvise(mapping, size, MADV_SEQUENTIAL);
+#endif
+
+  mapping_ = mapping;
+  data_ = static_cast<char const*>(mapping);
+  size_ = size;
+  is_open_ = true;
+  return true;
+}
+
+void mapped_file::close()
+{
+  if (mapping_)
+  {
+    munmap(mapping_, size_);
+    mapping_ = 0;
+  }
+  std::vector<char>().swap(buffer_);
+  data_ = 0;
+  size_ = 0;
+  is_open_ = false;
+}
+
+#endif
+
+bool mapped_file::read_into_buffer(std::string const & path)
+{
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+
+  char chunk[65536];
+  while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0)
+  {
+    buffer_.insert(buffer_.end(), chunk, chunk + file.gcount());
+  }
+
+  data_ = buffer_.empty() ? 0 : &buffer_[0];
+  size_ = buffer_.size();
+  is_open_ = true;
+  return true;
+}
+
+bool mapped_file::read_into_buffer(int descriptor)
+{
+  std::size_t size = 0;
+  for (;;)
+  {
+    if (buffer_.size() - size < read_chunk_size)
+    {
+      buffer_.resize(std::max(2*buffer_.size(), size + read_chunk_size));
+    }
+#ifdef _WIN32
+    int count = _read(descriptor, &buffer_[size], static_cast<unsigned int>(read_chunk_size));
+#else
+    ssize_t count = ::read(descriptor, &buffer_[size], read_chunk_size);
+#endif
+    if (count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (count < 0)
+    {
+      std::vector<char>().swap(buffer_);
+      return false;
+    }
+    if (count == 0)
+    {
+      break;
+    }
+    size += static_cast<std::size_t>(count);
+  }
+  buffer_.resize(size);
+
+  data_ = buffer_.empty() ? 0 : &buffer_[0];
+  size_ = buffer_.size();
+  is_open_ = true;
+  return true;
+}
+
+} //end of namespace filesystem
+} //end of namespace viennautils